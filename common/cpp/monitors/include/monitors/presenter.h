@@ -29,6 +29,7 @@ public:
     void addRemoveMonitor(MonitorType monitor);
     void handleKey(int key); // handles c, d, m, h keys
     void drawGraphs(cv::Mat& frame);
+    void setMemoryNote(const std::string& note); // shown under the memory graph
     std::string reportMeans() const;
 
     const int yPos;
@@ -40,5 +41,6 @@ private:
     CpuMonitor cpuMonitor;
     bool distributionCpuEnabled;
     MemoryMonitor memoryMonitor;
+    std::string memoryNote;
     std::ostringstream strStream;
 };
@@ -109,6 +109,10 @@ void Presenter::handleKey(int key) {
     }
 }
 
+void Presenter::setMemoryNote(const std::string& note) {
+    memoryNote = note;
+}
+
 void Presenter::drawGraphs(cv::Mat& frame) {
     const std::chrono::steady_clock::time_point curTimeStamp = std::chrono::steady_clock::now();
     if (curTimeStamp - prevTimeStamp >= std::chrono::milliseconds{1000}) {
@@ -283,6 +287,14 @@ void Presenter::drawGraphs(cv::Mat& frame) {
             cv::FONT_HERSHEY_SIMPLEX,
             textGraphSplittingLine * 0.04,
             {0, 35, 35});
+        if (!memoryNote.empty()) {
+            cv::putText(graph,
+                memoryNote,
+                cv::Point{graphPadding, graph.rows - graphPadding},
+                cv::FONT_HERSHEY_SIMPLEX,
+                textGraphSplittingLine * 0.04,
+                {0, 35, 35});
+        }
     }
 }
 
@@ -0,0 +1,145 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+///
+/// \brief Read-only view of a whole file, memory-mapped when possible.
+///
+/// Regular files are mapped, so reading them costs no copy; pipes and other
+/// unmappable inputs are read into a buffer instead.
+///
+class MappedFile {
+public:
+    ///
+    /// \brief Maps a file.
+    /// \param[in] path Path to the file.
+    ///
+    explicit MappedFile(const std::string &path);
+
+    ///
+    /// \brief Maps an open file descriptor (e.g. 0 for stdin). The
+    /// descriptor is not closed.
+    /// \param[in] fd File descriptor.
+    ///
+    static MappedFile FromDescriptor(int fd);
+
+    MappedFile(MappedFile &&other);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile() : data_(nullptr), size_(0), mapped_(false) {}
+
+    void Load(int fd, const std::string &name);
+
+    const char *data_;
+    size_t size_;
+    bool mapped_;         ///< data_ is a mapping, not buffer_.
+    std::string buffer_;  ///< Content of an input that could not be mapped.
+};
+
+///
+/// \brief Field of a CSV line, pointing into the parsed data.
+///
+struct CsvField {
+    const char *begin;
+    const char *end;
+
+    size_t size() const { return static_cast<size_t>(end - begin); }
+    std::string str() const { return std::string(begin, end); }
+};
+
+///
+/// \brief Parses a decimal integer like std::from_chars: no leading
+/// whitespace or plus sign.
+/// \param[in] begin Start of the text.
+/// \param[in] end End of the text.
+/// \param[out] value Parsed value, unchanged on error.
+/// \return Pointer past the number, nullptr if there is no number or it
+/// overflows.
+///
+const char *ParseInt(const char *begin, const char *end, int32_t *value);
+
+///
+/// \brief Parses a decimal floating point number ("-12.5", "1e-05") like
+/// std::from_chars. The result is within one unit in the last place.
+/// \param[in] begin Start of the text.
+/// \param[in] end End of the text.
+/// \param[out] value Parsed value, unchanged on error.
+/// \return Pointer past the number, nullptr if there is no number.
+///
+const char *ParseFloat(const char *begin, const char *end, float *value);
+
+///
+/// \brief Line by line reader of comma separated data without quoting, as
+/// written by pedestrian_tracker.
+///
+/// The fields point into the data, so nothing is copied or allocated per
+/// line. Empty lines are skipped and "\r\n" line ends are accepted.
+///
+class CsvReader {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] data Data to parse; must outlive the reader.
+    /// \param[in] size Size of the data.
+    ///
+    CsvReader(const char *data, size_t size);
+
+    ///
+    /// \brief Splits the next line into fields.
+    /// \return false at the end of the data.
+    ///
+    bool Next();
+
+    ///
+    /// \brief Number of fields of the current line.
+    ///
+    size_t size() const { return fields_.size(); }
+
+    ///
+    /// \brief Field of the current line.
+    /// \param[in] i Index of the field, less than size().
+    ///
+    const CsvField &field(size_t i) const { return fields_[i]; }
+
+    ///
+    /// \brief Parses a whole field as an integer.
+    /// \param[in] i Index of the field.
+    /// \param[out] value Parsed value.
+    /// \return false if the field is missing or not an integer.
+    ///
+    bool Int(size_t i, int32_t *value) const;
+
+    ///
+    /// \brief Parses a whole field as a floating point number.
+    /// \param[in] i Index of the field.
+    /// \param[out] value Parsed value.
+    /// \return false if the field is missing or not a number.
+    ///
+    bool Float(size_t i, float *value) const;
+
+    ///
+    /// \brief Number of the current line, starting at 1.
+    ///
+    size_t line() const { return line_; }
+
+private:
+    const char *pos_;
+    const char *end_;
+    size_t line_;
+    std::vector<CsvField> fields_;
+};
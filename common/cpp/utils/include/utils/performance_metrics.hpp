@@ -9,7 +9,9 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -27,6 +29,40 @@ public:
     struct Metrics {
         double latency;
         double fps;
+        double latencyP50;
+        double latencyP90;
+        double latencyP99;
+        double latencyMax;
+    };
+
+    /// Fixed-memory latency histogram with log-spaced buckets (HDR-style).
+    /// Every power-of-two range of microseconds is split into subBucketCount
+    /// linear buckets, so percentiles have a relative error below 1/subBucketCount
+    /// whatever the magnitude of the latency.
+    class Histogram {
+    public:
+        static const int subBucketBits = 4;
+        static const int subBucketCount = 1 << subBucketBits;
+        static const int maxExponent = 40;  // ~12 days in microseconds
+        static const int bucketCount = subBucketCount * (maxExponent - subBucketBits + 2);
+
+        Histogram();
+        void add(Duration latency);
+        void combine(const Histogram& other);
+        /// @param quantile value in [0, 1]
+        /// @returns latency in milliseconds or NaN if the histogram is empty
+        double percentile(double quantile) const;
+        /// @returns max latency in milliseconds or NaN if the histogram is empty
+        double max() const;
+        uint64_t count() const { return totalCount; }
+
+    private:
+        static int bucketIndex(uint64_t us);
+        static uint64_t bucketLowest(int index);
+
+        std::array<uint32_t, bucketCount> counts;
+        uint64_t totalCount;
+        Duration maxLatency;
     };
 
     PerformanceMetrics(Duration timeWindow = std::chrono::seconds(1));
@@ -61,6 +97,7 @@ private:
         Duration latency;
         Duration period;
         int frameCount;
+        Histogram histogram;
 
         Statistic() {
             latency = Duration::zero();
@@ -72,9 +109,12 @@ private:
             latency += other.latency;
             period += other.period;
             frameCount += other.frameCount;
+            histogram.combine(other.histogram);
         }
     };
 
+    static void setPercentiles(Metrics& metrics, const Histogram& histogram);
+
     Duration timeWindowSize;
     Statistic lastMovingStatistic;
     Statistic currentMovingStatistic;
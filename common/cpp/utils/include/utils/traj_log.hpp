@@ -0,0 +1,208 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+///
+/// \brief One row of the trajectory log (one tracked object on one frame).
+///
+struct TrajRow {
+    int32_t frame_idx;   ///< Frame index.
+    int32_t object_id;   ///< Object ID.
+    int32_t x;           ///< Bounding box.
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float confidence;    ///< Detection confidence.
+    uint64_t timestamp;  ///< Detection time in ms since epoch.
+};
+
+///
+/// \brief Per-file header of the binary trajectory log. These values are
+/// repeated on every row of the CSV log.
+///
+struct TrajLogHeader {
+    std::string location;  ///< Location of the camera.
+    std::string uuid;      ///< Run identifier ("<uuid>~<video name>").
+    uint64_t start_time;   ///< Time the log was started in ms since epoch.
+
+    TrajLogHeader() : start_time(0) {}
+};
+
+///
+/// \brief Index entry of one block of the binary trajectory log.
+///
+struct TrajBlockInfo {
+    uint64_t offset;       ///< Offset of the block in the file.
+    uint32_t row_count;    ///< Number of rows in the block.
+    int32_t first_frame;   ///< Min frame index in the block.
+    int32_t last_frame;    ///< Max frame index in the block.
+    uint64_t first_time;   ///< Min timestamp in the block.
+    uint64_t last_time;    ///< Max timestamp in the block.
+};
+
+///
+/// \brief Encoder of the binary trajectory log.
+///
+/// The file consists of a header, blocks of rows and a block index. Inside
+/// a block rows are stored column by column: frame indices, timestamps and
+/// object IDs as deltas to the previous row, box coordinates as deltas to
+/// the previous row of the same object, all as zigzag varints; confidences
+/// as raw floats. Every block starts with its own summary, so a file whose
+/// index was not written (e.g. after a crash) can still be read.
+///
+/// The encoder only produces bytes; the caller appends them to the file.
+///
+class TrajLogEncoder {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] rows_per_block Number of rows collected before a block is
+    /// emitted.
+    ///
+    explicit TrajLogEncoder(size_t rows_per_block = 4096);
+
+    ///
+    /// \brief Emits the file header. Must be called first.
+    /// \param[in] header Header to write.
+    /// \param[out] out Buffer the bytes are appended to.
+    ///
+    void Begin(const TrajLogHeader &header, std::string *out);
+
+    ///
+    /// \brief Adds a row. A full block is appended to out.
+    /// \param[in] row Row to add.
+    /// \param[out] out Buffer the bytes are appended to.
+    ///
+    void Add(const TrajRow &row, std::string *out);
+
+    ///
+    /// \brief Emits the collected rows as a block even if it is not full,
+    /// so they can be read back if the index is never written.
+    /// \param[out] out Buffer the bytes are appended to.
+    ///
+    void Flush(std::string *out);
+
+    ///
+    /// \brief Emits the last partial block and the block index.
+    /// \param[out] out Buffer the bytes are appended to.
+    ///
+    void Finish(std::string *out);
+
+private:
+    size_t rows_per_block_;
+    std::vector<TrajRow> rows_;
+    std::vector<TrajBlockInfo> index_;
+    uint64_t offset_;  ///< Number of bytes emitted so far.
+};
+
+///
+/// \brief Reader of the binary trajectory log.
+///
+class TrajLogReader {
+public:
+    ///
+    /// \brief Reads a log file. The file is mapped, not copied.
+    /// \param[in] path Path to the file.
+    ///
+    explicit TrajLogReader(const std::string &path);
+
+    ///
+    /// \brief Reads a log from memory without copying it (e.g. from a
+    /// MappedFile).
+    /// \param[in] data Log content; must outlive the reader.
+    /// \param[in] size Size of the content.
+    ///
+    TrajLogReader(const char *data, size_t size);
+
+    TrajLogReader(TrajLogReader &&other);
+    ~TrajLogReader();
+
+    ///
+    /// \brief Checks if the data starts like a binary trajectory log.
+    /// \param[in] data Start of the data (at least 8 bytes to be detected).
+    /// \param[in] size Size of the data.
+    ///
+    static bool IsTrajLog(const char *data, size_t size);
+
+    ///
+    /// \brief Header getter.
+    ///
+    const TrajLogHeader &header() const { return header_; }
+
+    ///
+    /// \brief Block index getter.
+    ///
+    const std::vector<TrajBlockInfo> &blocks() const { return blocks_; }
+
+    ///
+    /// \brief Decodes a block.
+    /// \param[in] i Block number.
+    /// \param[out] rows Decoded rows (replaces the content).
+    ///
+    void ReadBlock(size_t i, std::vector<TrajRow> *rows) const;
+
+    ///
+    /// \brief Decodes all rows.
+    /// \param[out] rows Decoded rows (replaces the content).
+    ///
+    void ReadAll(std::vector<TrajRow> *rows) const;
+
+private:
+    void Parse();
+
+    std::unique_ptr<MappedFile> file_;  ///< Owner of the data if read from a path.
+    const char *data_;
+    size_t size_;
+    TrajLogHeader header_;
+    std::vector<TrajBlockInfo> blocks_;
+};
+
+///
+/// \brief Formats a timestamp like asctime (local time, no newline).
+/// \param[in] timestamp Time in ms since epoch.
+///
+std::string FormatAscTime(uint64_t timestamp);
+
+///
+/// \brief Parses a time written by FormatAscTime.
+/// \param[in] begin Start of the text.
+/// \param[in] end End of the text.
+/// \param[out] timestamp Time in ms since epoch (whole seconds).
+/// \return false if the text is not an asctime string.
+///
+bool ParseAscTime(const char *begin, const char *end, uint64_t *timestamp);
+
+///
+/// \brief Formats a row exactly as the tracker writes it to the CSV log.
+/// \param[in] header Header of the log.
+/// \param[in] row Row to format.
+/// \param[out] out Buffer the line (with newline) is appended to.
+///
+void AppendTrajRowCsv(const TrajLogHeader &header, const TrajRow &row, std::string *out);
+
+///
+/// \brief Appends a string as a quoted and escaped JSON string.
+/// \param[in] s String to append.
+/// \param[out] out Buffer the JSON string is appended to.
+///
+void AppendJsonString(const std::string &s, std::string *out);
+
+///
+/// \brief Formats a row as one NDJSON line with the field names of the
+/// Logstash pipeline (frame, time, person, person_x, ..., uuid, vid). uuid
+/// and vid are numbers, as the pipeline converts them to float.
+/// \param[in] header Header of the log.
+/// \param[in] row Row to format.
+/// \param[out] out Buffer the line (with newline) is appended to.
+///
+void AppendTrajRowJson(const TrajLogHeader &header, const TrajRow &row, std::string *out);
@@ -0,0 +1,248 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "utils/csv_reader.hpp"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Exact powers of ten up to 1e22; larger exponents are applied in steps.
+const double kPowersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+double Scale(double v, int exponent) {
+    while (exponent > 22) {
+        v *= 1e22;
+        exponent -= 22;
+    }
+    while (exponent < -22) {
+        v /= 1e22;
+        exponent += 22;
+    }
+    return exponent >= 0 ? v * kPowersOf10[exponent] : v / kPowersOf10[-exponent];
+}
+
+bool IsDigit(char c) { return static_cast<unsigned>(c - '0') < 10; }
+}  // anonymous namespace
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0), mapped_(false) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Can't open " + path);
+    LARGE_INTEGER size;
+    bool ok = GetFileSizeEx(file, &size) != 0;
+    if (ok && size.QuadPart == 0) {
+        data_ = buffer_.data();
+    } else if (ok) {
+        // The view keeps the mapping alive after its handles are closed.
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (mapping) CloseHandle(mapping);
+        ok = data != nullptr;
+        if (ok) {
+            data_ = static_cast<const char *>(data);
+            size_ = static_cast<size_t>(size.QuadPart);
+            mapped_ = true;
+        }
+    }
+    CloseHandle(file);
+    if (!ok) throw std::runtime_error("Can't map " + path);
+}
+#else
+MappedFile::MappedFile(const std::string &path) : data_(nullptr), size_(0), mapped_(false) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Can't open " + path);
+    try {
+        Load(fd, path);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+#endif
+
+MappedFile MappedFile::FromDescriptor(int fd) {
+    MappedFile file;
+    file.Load(fd, "file descriptor " + std::to_string(fd));
+    return file;
+}
+
+MappedFile::MappedFile(MappedFile &&other)
+    : data_(other.data_), size_(other.size_), mapped_(other.mapped_), buffer_(std::move(other.buffer_)) {
+    if (!mapped_) data_ = buffer_.data();
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.mapped_ = false;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (mapped_) UnmapViewOfFile(data_);
+#else
+    if (mapped_) munmap(const_cast<char *>(data_), size_);
+#endif
+}
+
+#ifdef _WIN32
+void MappedFile::Load(int fd, const std::string &name) {
+    // Descriptors (stdin) are read into the buffer, without the CRLF
+    // translation of text mode.
+    _setmode(fd, _O_BINARY);
+    char chunk[1 << 16];
+    int n;
+    while ((n = _read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer_.append(chunk, static_cast<size_t>(n));
+    }
+    if (n < 0) throw std::runtime_error("Can't read " + name);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+#else
+void MappedFile::Load(int fd, const std::string &name) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) throw std::runtime_error("Can't stat " + name);
+    // A regular file read from its start can be mapped; stdin redirected
+    // from a file usually is one.
+    if (S_ISREG(st.st_mode) && lseek(fd, 0, SEEK_CUR) == 0) {
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) {
+            data_ = buffer_.data();
+            return;
+        }
+        void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(data);
+            mapped_ = true;
+            return;
+        }
+    }
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer_.append(chunk, static_cast<size_t>(n));
+    }
+    if (n < 0) throw std::runtime_error("Can't read " + name);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+#endif
+
+const char *ParseInt(const char *begin, const char *end, int32_t *value) {
+    const char *p = begin;
+    bool negative = p != end && *p == '-';
+    if (negative) ++p;
+    if (p == end || !IsDigit(*p)) return nullptr;
+    // Accumulated as a negative number, which can also hold INT32_MIN.
+    int64_t v = 0;
+    for (; p != end && IsDigit(*p); ++p) {
+        v = v * 10 - (*p - '0');
+        if (v < std::numeric_limits<int32_t>::min()) return nullptr;
+    }
+    if (!negative) {
+        if (v < -std::numeric_limits<int32_t>::max()) return nullptr;
+        v = -v;
+    }
+    *value = static_cast<int32_t>(v);
+    return p;
+}
+
+const char *ParseFloat(const char *begin, const char *end, float *value) {
+    const char *p = begin;
+    bool negative = p != end && *p == '-';
+    if (negative) ++p;
+
+    // Up to 19 significant digits fit in the mantissa; the rest only move
+    // the exponent.
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; p != end && IsDigit(*p); ++p, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            if (mantissa != 0) digits++;
+        } else {
+            exponent++;
+        }
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && IsDigit(*p); ++p, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                if (mantissa != 0) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return nullptr;
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        int32_t e_value;
+        if (e != end && *e == '+') ++e;
+        const char *e_end = ParseInt(e, end, &e_value);
+        // "1e" is the number 1 followed by "e", as in from_chars.
+        if (e_end) {
+            exponent += e_value < -400 ? -400 : e_value > 400 ? 400 : e_value;
+            p = e_end;
+        }
+    }
+    double v = Scale(static_cast<double>(mantissa), exponent);
+    *value = static_cast<float>(negative ? -v : v);
+    return p;
+}
+
+CsvReader::CsvReader(const char *data, size_t size) : pos_(data), end_(data + size), line_(0) {}
+
+bool CsvReader::Next() {
+    while (pos_ < end_) {
+        const char *eol = static_cast<const char *>(memchr(pos_, '\n', static_cast<size_t>(end_ - pos_)));
+        if (!eol) eol = end_;
+        const char *line_end = eol;
+        if (line_end > pos_ && line_end[-1] == '\r') --line_end;
+        const char *start = pos_;
+        pos_ = eol + (eol < end_ ? 1 : 0);
+        line_++;
+        if (start == line_end) continue;
+
+        fields_.clear();
+        for (;;) {
+            const char *comma =
+                static_cast<const char *>(memchr(start, ',', static_cast<size_t>(line_end - start)));
+            if (!comma) break;
+            fields_.push_back(CsvField{start, comma});
+            start = comma + 1;
+        }
+        fields_.push_back(CsvField{start, line_end});
+        return true;
+    }
+    return false;
+}
+
+bool CsvReader::Int(size_t i, int32_t *value) const {
+    if (i >= fields_.size()) return false;
+    const CsvField &f = fields_[i];
+    return ParseInt(f.begin, f.end, value) == f.end;
+}
+
+bool CsvReader::Float(size_t i, float *value) const {
+    if (i >= fields_.size()) return false;
+    const CsvField &f = fields_[i];
+    return ParseFloat(f.begin, f.end, value) == f.end;
+}
@@ -4,8 +4,83 @@
 
 #include "utils/performance_metrics.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
+PerformanceMetrics::Histogram::Histogram()
+    : totalCount(0)
+    , maxLatency(Duration::zero()) {
+    counts.fill(0);
+}
+
+int PerformanceMetrics::Histogram::bucketIndex(uint64_t us) {
+    if (us < subBucketCount) {
+        return static_cast<int>(us);
+    }
+    int exponent = subBucketBits;
+    while (exponent < 63 && (us >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+    if (exponent > maxExponent) {
+        return bucketCount - 1;
+    }
+    // The top subBucketBits + 1 bits select the bucket within the power of two
+    int shift = exponent - subBucketBits;
+    return (shift << subBucketBits) + static_cast<int>(us >> shift);
+}
+
+uint64_t PerformanceMetrics::Histogram::bucketLowest(int index) {
+    if (index < subBucketCount) {
+        return static_cast<uint64_t>(index);
+    }
+    int shift = index / subBucketCount - 1;
+    return static_cast<uint64_t>(index - (shift << subBucketBits)) << shift;
+}
+
+void PerformanceMetrics::Histogram::add(Duration latency) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    counts[bucketIndex(us > 0 ? static_cast<uint64_t>(us) : 0)]++;
+    totalCount++;
+    maxLatency = std::max(maxLatency, latency);
+}
+
+void PerformanceMetrics::Histogram::combine(const Histogram& other) {
+    for (int i = 0; i < bucketCount; i++) {
+        counts[i] += other.counts[i];
+    }
+    totalCount += other.totalCount;
+    maxLatency = std::max(maxLatency, other.maxLatency);
+}
+
+double PerformanceMetrics::Histogram::percentile(double quantile) const {
+    if (totalCount == 0) {
+        return std::numeric_limits<double>::signaling_NaN();
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * totalCount));
+    rank = std::min(std::max<uint64_t>(rank, 1), totalCount);
+    uint64_t seen = 0;
+    int index = 0;
+    for (; index < bucketCount - 1; index++) {
+        seen += counts[index];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    // Middle of the bucket, but never above the largest recorded latency
+    double lowest = static_cast<double>(bucketLowest(index));
+    double width = index + 1 < bucketCount ? bucketLowest(index + 1) - bucketLowest(index) : 1;
+    double ms = (lowest + (width - 1) / 2) / 1000;
+    return std::min(ms, max());
+}
+
+double PerformanceMetrics::Histogram::max() const {
+    if (totalCount == 0) {
+        return std::numeric_limits<double>::signaling_NaN();
+    }
+    return std::chrono::duration_cast<Ms>(maxLatency).count();
+}
+
 // timeWindow defines the length of the timespan over which the 'current fps' value is calculated
 PerformanceMetrics::PerformanceMetrics(Duration timeWindow)
     : timeWindowSize(timeWindow)
@@ -32,6 +107,7 @@ void PerformanceMetrics::update(TimePoint lastRequestStartTime) {
     }
 
     currentMovingStatistic.latency += currentTime - lastRequestStartTime;
+    currentMovingStatistic.histogram.add(currentTime - lastRequestStartTime);
     currentMovingStatistic.period = currentTime - lastUpdateTime;
     currentMovingStatistic.frameCount++;
 
@@ -58,6 +134,19 @@ void PerformanceMetrics::paintMetrics(cv::Mat & frame, cv::Point position, int f
         out << "FPS: " << std::fixed << std::setprecision(1) << metrics.fps;
         putHighlightedText(frame, out.str(), {position.x, position.y + 30}, fontFace, fontScale, color, thickness);
     }
+    if (!std::isnan(metrics.latencyP99)) {
+        out.str("");
+        out << "p90/p99/max: " << std::fixed << std::setprecision(1) << metrics.latencyP90 << "/"
+            << metrics.latencyP99 << "/" << metrics.latencyMax << " ms";
+        putHighlightedText(frame, out.str(), {position.x, position.y + 60}, fontFace, fontScale, color, thickness);
+    }
+}
+
+void PerformanceMetrics::setPercentiles(Metrics& metrics, const Histogram& histogram) {
+    metrics.latencyP50 = histogram.percentile(0.5);
+    metrics.latencyP90 = histogram.percentile(0.9);
+    metrics.latencyP99 = histogram.percentile(0.99);
+    metrics.latencyMax = histogram.max();
 }
 
 PerformanceMetrics::Metrics PerformanceMetrics::getLast() const {
@@ -71,6 +160,7 @@ PerformanceMetrics::Metrics PerformanceMetrics::getLast() const {
                   ? lastMovingStatistic.frameCount
                     / std::chrono::duration_cast<Sec>(lastMovingStatistic.period).count()
                   : std::numeric_limits<double>::signaling_NaN();
+    setPercentiles(metrics, lastMovingStatistic.histogram);
 
     return metrics;
 }
@@ -88,6 +178,9 @@ PerformanceMetrics::Metrics PerformanceMetrics::getTotal() const {
         metrics.latency = std::numeric_limits<double>::signaling_NaN();
         metrics.fps = std::numeric_limits<double>::signaling_NaN();
     }
+    Histogram histogram = totalStatistic.histogram;
+    histogram.combine(currentMovingStatistic.histogram);
+    setPercentiles(metrics, histogram);
 
     return metrics;
 }
@@ -97,5 +190,9 @@ void PerformanceMetrics::printTotal() const {
 
     std::ostringstream out;
     out << "Latency: " << std::fixed << std::setprecision(1) << metrics.latency << " ms\nFPS: " << metrics.fps << '\n';
+    if (!std::isnan(metrics.latencyMax)) {
+        out << "Latency p50/p90/p99/max: " << metrics.latencyP50 << "/" << metrics.latencyP90 << "/"
+            << metrics.latencyP99 << "/" << metrics.latencyMax << " ms\n";
+    }
     std::cout << out.str();
 }
@@ -0,0 +1,532 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include "utils/traj_log.hpp"
+
+#include "utils/csv_reader.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+const char kFileMagic[8] = {'P', 'T', 'T', 'R', 'A', 'J', '0', '1'};
+const char kIndexMagic[8] = {'P', 'T', 'T', 'R', 'A', 'J', 'I', 'X'};
+const uint32_t kBlockMagic = 0x31424c4b;  // "KLB1"
+const uint32_t kVersion = 1;
+
+// Block summary: magic, row count, payload size, frames, times.
+const size_t kBlockHeaderSize = 4 + 4 + 4 + 4 + 4 + 8 + 8;
+// Index entry: offset, row count, frames, times.
+const size_t kIndexEntrySize = 8 + 4 + 4 + 4 + 8 + 8;
+// Index tail: index offset, magic.
+const size_t kIndexTailSize = 8 + sizeof(kIndexMagic);
+// Smallest encoded row: seven one byte varints and the confidence.
+const size_t kMinRowSize = 7 + 4;
+
+void PutU32(uint32_t v, std::string *out) {
+    for (int i = 0; i < 4; i++) out->push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+void PutU64(uint64_t v, std::string *out) {
+    for (int i = 0; i < 8; i++) out->push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+void PutVarint(uint64_t v, std::string *out) {
+    while (v >= 0x80) {
+        out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out->push_back(static_cast<char>(v));
+}
+
+void PutSigned(int64_t v, std::string *out) {
+    PutVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63), out);
+}
+
+void PutString(const std::string &s, std::string *out) {
+    PutU32(static_cast<uint32_t>(s.size()), out);
+    out->append(s);
+}
+
+// Bounds-checked little-endian reader over a byte range.
+class ByteReader {
+public:
+    ByteReader(const char *data, size_t size, size_t pos, size_t end) : data_(data), pos_(pos), end_(end) {
+        if (pos > end || end > size) {
+            throw std::runtime_error("Corrupted trajectory log: offset out of range");
+        }
+    }
+
+    size_t pos() const { return pos_; }
+
+    bool Has(size_t n) const { return end_ - pos_ >= n; }
+
+    uint32_t U32() {
+        Need(4);
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(Byte(pos_ + i)) << (8 * i);
+        pos_ += 4;
+        return v;
+    }
+
+    uint64_t U64() {
+        Need(8);
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(Byte(pos_ + i)) << (8 * i);
+        pos_ += 8;
+        return v;
+    }
+
+    uint64_t Varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            Need(1);
+            uint8_t b = Byte(pos_++);
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        throw std::runtime_error("Corrupted trajectory log: bad varint");
+    }
+
+    int64_t Signed() {
+        uint64_t v = Varint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+    std::string String() {
+        uint32_t size = U32();
+        Need(size);
+        std::string s(data_ + pos_, size);
+        pos_ += size;
+        return s;
+    }
+
+private:
+    uint8_t Byte(size_t i) const { return static_cast<uint8_t>(data_[i]); }
+
+    void Need(size_t n) const {
+        if (!Has(n)) throw std::runtime_error("Corrupted trajectory log: unexpected end of data");
+    }
+
+    const char *data_;
+    size_t pos_;
+    size_t end_;
+};
+
+struct Box {
+    int32_t x, y, width, height;
+};
+
+}  // anonymous namespace
+
+TrajLogEncoder::TrajLogEncoder(size_t rows_per_block)
+    : rows_per_block_(rows_per_block), offset_(0) {
+    rows_.reserve(rows_per_block_);
+}
+
+void TrajLogEncoder::Begin(const TrajLogHeader &header, std::string *out) {
+    size_t start = out->size();
+    out->append(kFileMagic, sizeof(kFileMagic));
+    PutU32(kVersion, out);
+    PutU64(header.start_time, out);
+    PutString(header.location, out);
+    PutString(header.uuid, out);
+    offset_ += out->size() - start;
+}
+
+void TrajLogEncoder::Add(const TrajRow &row, std::string *out) {
+    rows_.push_back(row);
+    if (rows_.size() >= rows_per_block_) {
+        Flush(out);
+    }
+}
+
+void TrajLogEncoder::Finish(std::string *out) {
+    Flush(out);
+
+    size_t start = out->size();
+    uint64_t index_offset = offset_;
+    PutU32(static_cast<uint32_t>(index_.size()), out);
+    for (const auto &block : index_) {
+        PutU64(block.offset, out);
+        PutU32(block.row_count, out);
+        PutU32(static_cast<uint32_t>(block.first_frame), out);
+        PutU32(static_cast<uint32_t>(block.last_frame), out);
+        PutU64(block.first_time, out);
+        PutU64(block.last_time, out);
+    }
+    PutU64(index_offset, out);
+    out->append(kIndexMagic, sizeof(kIndexMagic));
+    offset_ += out->size() - start;
+}
+
+void TrajLogEncoder::Flush(std::string *out) {
+    if (rows_.empty()) return;
+
+    TrajBlockInfo info;
+    info.offset = offset_;
+    info.row_count = static_cast<uint32_t>(rows_.size());
+    info.first_frame = info.last_frame = rows_.front().frame_idx;
+    info.first_time = info.last_time = rows_.front().timestamp;
+    for (const auto &row : rows_) {
+        info.first_frame = std::min(info.first_frame, row.frame_idx);
+        info.last_frame = std::max(info.last_frame, row.frame_idx);
+        info.first_time = std::min(info.first_time, row.timestamp);
+        info.last_time = std::max(info.last_time, row.timestamp);
+    }
+
+    std::string payload;
+    int64_t prev = info.first_frame;
+    for (const auto &row : rows_) {
+        PutSigned(row.frame_idx - prev, &payload);
+        prev = row.frame_idx;
+    }
+    prev = static_cast<int64_t>(info.first_time);
+    for (const auto &row : rows_) {
+        PutSigned(static_cast<int64_t>(row.timestamp) - prev, &payload);
+        prev = static_cast<int64_t>(row.timestamp);
+    }
+    prev = 0;
+    for (const auto &row : rows_) {
+        PutSigned(row.object_id - prev, &payload);
+        prev = row.object_id;
+    }
+    // Boxes of the same object change little from frame to frame.
+    std::unordered_map<int32_t, Box> last_box;
+    std::string xs, ys, widths, heights;
+    for (const auto &row : rows_) {
+        Box &box = last_box.emplace(row.object_id, Box{0, 0, 0, 0}).first->second;
+        PutSigned(static_cast<int64_t>(row.x) - box.x, &xs);
+        PutSigned(static_cast<int64_t>(row.y) - box.y, &ys);
+        PutSigned(static_cast<int64_t>(row.width) - box.width, &widths);
+        PutSigned(static_cast<int64_t>(row.height) - box.height, &heights);
+        box = Box{row.x, row.y, row.width, row.height};
+    }
+    payload += xs;
+    payload += ys;
+    payload += widths;
+    payload += heights;
+    for (const auto &row : rows_) {
+        uint32_t bits;
+        std::memcpy(&bits, &row.confidence, sizeof(bits));
+        PutU32(bits, &payload);
+    }
+
+    size_t start = out->size();
+    PutU32(kBlockMagic, out);
+    PutU32(info.row_count, out);
+    PutU32(static_cast<uint32_t>(payload.size()), out);
+    PutU32(static_cast<uint32_t>(info.first_frame), out);
+    PutU32(static_cast<uint32_t>(info.last_frame), out);
+    PutU64(info.first_time, out);
+    PutU64(info.last_time, out);
+    out->append(payload);
+    offset_ += out->size() - start;
+
+    index_.push_back(info);
+    rows_.clear();
+}
+
+TrajLogReader::TrajLogReader(const std::string &path)
+    : file_(new MappedFile(path)), data_(file_->data()), size_(file_->size()) {
+    Parse();
+}
+
+TrajLogReader::TrajLogReader(const char *data, size_t size) : data_(data), size_(size) {
+    Parse();
+}
+
+TrajLogReader::TrajLogReader(TrajLogReader &&other) = default;
+
+TrajLogReader::~TrajLogReader() = default;
+
+bool TrajLogReader::IsTrajLog(const char *data, size_t size) {
+    return size >= sizeof(kFileMagic) && std::memcmp(data, kFileMagic, sizeof(kFileMagic)) == 0;
+}
+
+void TrajLogReader::Parse() {
+    if (!IsTrajLog(data_, size_)) {
+        throw std::runtime_error("Not a binary trajectory log");
+    }
+    ByteReader header(data_, size_, sizeof(kFileMagic), size_);
+    uint32_t version = header.U32();
+    if (version != kVersion) {
+        throw std::runtime_error("Unsupported trajectory log version " + std::to_string(version));
+    }
+    header_.start_time = header.U64();
+    header_.location = header.String();
+    header_.uuid = header.String();
+    size_t blocks_start = header.pos();
+
+    // Use the index if the log was closed properly.
+    if (size_ >= blocks_start + kIndexTailSize &&
+        std::memcmp(data_ + size_ - sizeof(kIndexMagic), kIndexMagic, sizeof(kIndexMagic)) == 0) {
+        ByteReader tail(data_, size_, size_ - kIndexTailSize, size_);
+        uint64_t index_offset = tail.U64();
+        if (index_offset < blocks_start || index_offset > size_ - kIndexTailSize) {
+            throw std::runtime_error("Corrupted trajectory log: bad block index");
+        }
+        ByteReader index(data_, size_, static_cast<size_t>(index_offset), size_ - kIndexTailSize);
+        uint32_t count = index.U32();
+        if (!index.Has(static_cast<size_t>(count) * kIndexEntrySize)) {
+            throw std::runtime_error("Corrupted trajectory log: bad block index");
+        }
+        blocks_.resize(count);
+        for (auto &block : blocks_) {
+            block.offset = index.U64();
+            block.row_count = index.U32();
+            block.first_frame = static_cast<int32_t>(index.U32());
+            block.last_frame = static_cast<int32_t>(index.U32());
+            block.first_time = index.U64();
+            block.last_time = index.U64();
+            // Blocks lie between the header and the index.
+            if (block.offset < blocks_start || block.offset > index_offset ||
+                index_offset - block.offset < kBlockHeaderSize) {
+                throw std::runtime_error("Corrupted trajectory log: bad block index");
+            }
+        }
+        return;
+    }
+
+    // Otherwise rebuild the index from block summaries, ignoring a truncated
+    // last block.
+    size_t pos = blocks_start;
+    while (size_ - pos >= kBlockHeaderSize) {
+        ByteReader block(data_, size_, pos, size_);
+        if (block.U32() != kBlockMagic) break;
+        TrajBlockInfo info;
+        info.offset = pos;
+        info.row_count = block.U32();
+        uint32_t payload_size = block.U32();
+        info.first_frame = static_cast<int32_t>(block.U32());
+        info.last_frame = static_cast<int32_t>(block.U32());
+        info.first_time = block.U64();
+        info.last_time = block.U64();
+        if (!block.Has(payload_size)) break;
+        blocks_.push_back(info);
+        pos = block.pos() + payload_size;
+    }
+}
+
+void TrajLogReader::ReadBlock(size_t i, std::vector<TrajRow> *rows) const {
+    const TrajBlockInfo &info = blocks_.at(i);
+    if (info.offset > size_ || size_ - info.offset < kBlockHeaderSize) {
+        throw std::runtime_error("Corrupted trajectory log: bad block");
+    }
+    size_t payload_start = static_cast<size_t>(info.offset) + kBlockHeaderSize;
+    ByteReader summary(data_, size_, static_cast<size_t>(info.offset), payload_start);
+    if (summary.U32() != kBlockMagic) {
+        throw std::runtime_error("Corrupted trajectory log: bad block");
+    }
+    size_t count = summary.U32();
+    size_t payload_size = summary.U32();
+    // The row count is checked against the payload before it is allocated.
+    if (payload_size > size_ - payload_start || count > payload_size / kMinRowSize) {
+        throw std::runtime_error("Corrupted trajectory log: bad block");
+    }
+    ByteReader in(data_, size_, payload_start, payload_start + payload_size);
+
+    rows->resize(count);
+    int64_t prev = info.first_frame;
+    for (auto &row : *rows) {
+        prev += in.Signed();
+        row.frame_idx = static_cast<int32_t>(prev);
+    }
+    prev = static_cast<int64_t>(info.first_time);
+    for (auto &row : *rows) {
+        prev += in.Signed();
+        row.timestamp = static_cast<uint64_t>(prev);
+    }
+    prev = 0;
+    for (auto &row : *rows) {
+        prev += in.Signed();
+        row.object_id = static_cast<int32_t>(prev);
+    }
+    std::unordered_map<int32_t, Box> last_box;
+    std::vector<Box *> boxes(count);
+    for (size_t j = 0; j < count; j++) {
+        boxes[j] = &last_box.emplace((*rows)[j].object_id, Box{0, 0, 0, 0}).first->second;
+    }
+    // Each coordinate column is decoded separately, so walk the rows once per
+    // column, replaying the per-object deltas.
+    int32_t Box::*fields[] = {&Box::x, &Box::y, &Box::width, &Box::height};
+    int32_t TrajRow::*row_fields[] = {&TrajRow::x, &TrajRow::y, &TrajRow::width, &TrajRow::height};
+    for (size_t f = 0; f < 4; f++) {
+        for (auto &entry : last_box) entry.second.*fields[f] = 0;
+        for (size_t j = 0; j < count; j++) {
+            int32_t &value = boxes[j]->*fields[f];
+            value = static_cast<int32_t>(value + in.Signed());
+            (*rows)[j].*row_fields[f] = value;
+        }
+    }
+    for (auto &row : *rows) {
+        uint32_t bits = in.U32();
+        std::memcpy(&row.confidence, &bits, sizeof(bits));
+    }
+}
+
+void TrajLogReader::ReadAll(std::vector<TrajRow> *rows) const {
+    rows->clear();
+    std::vector<TrajRow> block;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        ReadBlock(i, &block);
+        rows->insert(rows->end(), block.begin(), block.end());
+    }
+}
+
+void AppendJsonString(const std::string &s, std::string *out) {
+    out->push_back('"');
+    for (char c : s) {
+        switch (c) {
+        case '"': out->append("\\\""); break;
+        case '\\': out->append("\\\\"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out->append(buf);
+            } else {
+                out->push_back(c);
+            }
+        }
+    }
+    out->push_back('"');
+}
+
+std::string FormatAscTime(uint64_t timestamp) {
+    // Consecutive rows usually share the second, so the last result is cached.
+    thread_local time_t last_sec = -1;
+    thread_local std::string last_str;
+
+    time_t sec = static_cast<time_t>(timestamp / 1000);
+    if (sec != last_sec) {
+        struct tm local;
+        char buf[32];
+#ifdef _WIN32
+        localtime_s(&local, &sec);
+        asctime_s(buf, sizeof(buf), &local);
+#else
+        localtime_r(&sec, &local);
+        asctime_r(&local, buf);
+#endif
+        last_str.assign(buf);
+        last_str.pop_back();
+        last_sec = sec;
+    }
+    return last_str;
+}
+
+bool ParseAscTime(const char *begin, const char *end, uint64_t *timestamp) {
+    // Consecutive rows usually share the second, so the last result is cached.
+    thread_local std::string last_str;
+    thread_local uint64_t last_time = 0;
+
+    size_t size = static_cast<size_t>(end - begin);
+    if (size == last_str.size() && memcmp(begin, last_str.data(), size) == 0) {
+        *timestamp = last_time;
+        return true;
+    }
+    // "Www Mmm dd hh:mm:ss yyyy", the day padded with a space.
+    static const char kMonths[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (size < 24 || begin[3] != ' ' || begin[7] != ' ' || begin[10] != ' ' || begin[13] != ':' ||
+        begin[16] != ':' || begin[19] != ' ') {
+        return false;
+    }
+    const char *month = nullptr;
+    for (const char *m = kMonths; *m; m += 3) {
+        if (memcmp(m, begin + 4, 3) == 0) month = m;
+    }
+    auto number = [](const char *p, int digits, bool pad, int *value) {
+        *value = 0;
+        for (int i = 0; i < digits; i++) {
+            if (pad && i == 0 && p[i] == ' ') continue;
+            if (p[i] < '0' || p[i] > '9') return false;
+            *value = *value * 10 + (p[i] - '0');
+        }
+        return true;
+    };
+    struct tm local = tm();
+    int year;
+    if (!month || !number(begin + 8, 2, true, &local.tm_mday) || !number(begin + 11, 2, false, &local.tm_hour) ||
+        !number(begin + 14, 2, false, &local.tm_min) || !number(begin + 17, 2, false, &local.tm_sec) ||
+        !number(begin + 20, static_cast<int>(size - 20), false, &year)) {
+        return false;
+    }
+    local.tm_mon = static_cast<int>(month - kMonths) / 3;
+    local.tm_year = year - 1900;
+    local.tm_isdst = -1;
+    time_t sec = mktime(&local);
+    if (sec < 0) return false;
+
+    last_str.assign(begin, size);
+    last_time = static_cast<uint64_t>(sec) * 1000;
+    *timestamp = last_time;
+    return true;
+}
+
+void AppendTrajRowCsv(const TrajLogHeader &header, const TrajRow &row, std::string *out) {
+    char buf[96];
+    int n = snprintf(buf, sizeof(buf), "%d,", row.frame_idx);
+    out->append(buf, n);
+    out->append(FormatAscTime(row.timestamp));
+    n = snprintf(buf, sizeof(buf), ",%d,%d,%d,%d,%d,%g,",
+                 row.object_id, row.x, row.y, row.width, row.height, row.confidence);
+    out->append(buf, n);
+    out->append(header.location);
+    out->push_back(',');
+    out->append(header.uuid);
+    out->push_back('\n');
+}
+
+namespace {
+// Appends the number the Logstash pipeline makes of a text field it converts
+// to float (Ruby String#to_f): the leading decimal number, 0 if there is none.
+void AppendPipelineFloat(const std::string &text, std::string *out) {
+    const char *begin = text.c_str();
+    const char *end = begin + text.size();
+    while (begin != end && std::isspace(static_cast<unsigned char>(*begin))) ++begin;
+    if (begin != end && *begin == '+' && begin + 1 != end && begin[1] != '-') ++begin;
+    float value = 0;
+    ParseFloat(begin, end, &value);
+    if (!std::isfinite(value)) {
+        out->append("null");
+        return;
+    }
+    // Written with a fraction, so a new index maps the field as a float too.
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%.9g", value);
+    out->append(buf, n);
+    if (!strpbrk(buf, ".e")) out->append(".0");
+}
+}  // anonymous namespace
+
+void AppendTrajRowJson(const TrajLogHeader &header, const TrajRow &row, std::string *out) {
+    char buf[160];
+    size_t sep = header.uuid.find('~');
+    std::string uuid = header.uuid.substr(0, sep);
+    std::string vid = sep == std::string::npos ? "" : header.uuid.substr(sep + 1);
+
+    int n = snprintf(buf, sizeof(buf), "{\"frame\":%d,\"time\":", row.frame_idx);
+    out->append(buf, n);
+    AppendJsonString(FormatAscTime(row.timestamp), out);
+    n = snprintf(buf, sizeof(buf),
+                 ",\"person\":%d,\"person_x\":%d,\"person_y\":%d,\"person_width\":%d,"
+                 "\"person_height\":%d,\"confidence_level\":%g,\"location\":",
+                 row.object_id, row.x, row.y, row.width, row.height, row.confidence);
+    out->append(buf, n);
+    AppendJsonString(header.location, out);
+    out->append(",\"uuid\":");
+    AppendPipelineFloat(uuid, out);
+    out->append(",\"vid\":");
+    AppendPipelineFloat(vid, out);
+    out->append("}\n");
+}
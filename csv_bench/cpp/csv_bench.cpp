@@ -0,0 +1,182 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Compares the istream based trajectory log parsers that heatmap_gen and the
+// offline direction log used before the shared CsvReader with the current
+// ones, on a generated log.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <utils/csv_reader.hpp>
+#include <utils/traj_log.hpp>
+
+#include "logObject.hpp"
+
+namespace {
+// heatmap_gen before the CsvReader: one stringstream and a vector of strings
+// per line.
+std::vector<int> OldFeetFromCsv(std::string line) {
+    std::vector<int> result;
+    std::vector<std::string> temp;
+    std::stringstream s_stream(line);
+    while (s_stream.good()) {
+        std::string substr;
+        std::getline(s_stream, substr, ',');
+        temp.push_back(substr);
+    }
+    try {
+        result.push_back(std::stoi(temp[3]) + std::stoi(temp[5]) / 2);
+        result.push_back(std::stoi(temp[4]) + std::stoi(temp[6]));
+    } catch (const std::exception &) {
+        result.assign(2, 0);
+    }
+    return result;
+}
+
+// heatmap_gen now.
+bool FeetFromCsv(const CsvReader &row, int32_t *x, int32_t *y) {
+    int32_t box_x, box_y, box_w, box_h;
+    if (!row.Int(3, &box_x) || !row.Int(4, &box_y) || !row.Int(5, &box_w) || !row.Int(6, &box_h)) {
+        return false;
+    }
+    *x = box_x + box_w / 2;
+    *y = box_y + box_h;
+    return true;
+}
+
+// LogInformation before the CsvReader, reading a stringstream of the line.
+struct OldLogInformation {
+    std::string segment;
+    std::string frameNumber;
+    std::string dateTime;
+    std::string location;
+    int x_Location;
+    int y_Location;
+    int x_box;
+    int y_box;
+    int confidence;
+    int uniqueID;
+
+    explicit OldLogInformation(std::stringstream &log) {
+        int i = 0;
+        while (getline(log, segment, ',')) {
+            switch (i) {
+            case 0: frameNumber = segment; break;
+            case 1: dateTime = segment; break;
+            case 2: uniqueID = std::stoi(segment); break;
+            case 3: x_Location = std::stoi(segment); break;
+            case 4: y_Location = std::stoi(segment); break;
+            case 5: x_box = std::stoi(segment); break;
+            case 6: y_box = std::stoi(segment); break;
+            case 7: confidence = std::stoi(segment); break;
+            case 8: location = segment; break;
+            default: break;
+            }
+            i++;
+        }
+    }
+};
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Report(const char *name, size_t rows, double old_s, double new_s, bool same) {
+    printf("%-10s old %6.2fM rows/s  new %6.2fM rows/s  %5.1fx%s\n", name, rows / old_s / 1e6,
+           rows / new_s / 1e6, old_s / new_s, same ? "" : "  RESULTS DIFFER");
+}
+}  // anonymous namespace
+
+int main(int argc, char *argv[]) {
+    try {
+        size_t rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+        if (argc > 2 || rows == 0) {
+            std::cout << "Usage: " << argv[0] << " [ROWS]" << std::endl;
+            std::cout << "  Writes a trajectory log of ROWS rows (default 2000000) to a temporary" << std::endl;
+            std::cout << "  file and parses it with the old and the new parsers." << std::endl;
+            return 1;
+        }
+
+        char path[] = "/tmp/csv_bench-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) throw std::runtime_error("Can't create a temporary file");
+        close(fd);
+        {
+            TrajLogHeader header;
+            header.location = "New Demo Location 3";
+            header.uuid = "4a3b8c1f~video.mp4";
+            std::string csv;
+            srand(3);
+            for (size_t i = 0; i < rows; i++) {
+                TrajRow row{static_cast<int32_t>(i / 5), static_cast<int32_t>(i % 5), rand() % 1800, rand() % 1000,
+                            20 + rand() % 50, 50 + rand() % 80, 0.931894f, 1629689847000ULL + i * 40};
+                AppendTrajRowCsv(header, row, &csv);
+            }
+            std::ofstream(path, std::ios::binary) << csv;
+        }
+
+        // Both sides read the file from disk, so the page cache is warm for
+        // both after the first pass.
+        int64_t old_sum = 0, new_sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line)) {
+                std::vector<int> feet = OldFeetFromCsv(line);
+                old_sum += feet[0] + feet[1];
+            }
+        }
+        double old_s = Seconds(start);
+        start = std::chrono::steady_clock::now();
+        {
+            MappedFile file(path);
+            CsvReader reader(file.data(), file.size());
+            int32_t x, y;
+            while (reader.Next()) {
+                if (FeetFromCsv(reader, &x, &y)) new_sum += x + y;
+            }
+        }
+        Report("heatmap", rows, old_s, Seconds(start), old_sum == new_sum);
+
+        old_sum = new_sum = 0;
+        start = std::chrono::steady_clock::now();
+        {
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line)) {
+                std::stringstream iss(line);
+                OldLogInformation info(iss);
+                old_sum += info.uniqueID + info.x_Location + info.y_Location + info.dateTime.size();
+            }
+        }
+        old_s = Seconds(start);
+        start = std::chrono::steady_clock::now();
+        {
+            MappedFile file(path);
+            CsvReader reader(file.data(), file.size());
+            while (reader.Next()) {
+                LogInformation info(reader);
+                new_sum += info.uniqueID + info.x_Location + info.y_Location + info.dateTime.size();
+            }
+        }
+        Report("direction", rows, old_s, Seconds(start), old_sum == new_sum);
+
+        unlink(path);
+    } catch (const std::exception &error) {
+        std::cerr << "[ ERROR ] " << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
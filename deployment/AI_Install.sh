@@ -15,7 +15,7 @@ apt-get -y install curl
 apt-get -y install build-essential cmake unzip pkg-config
 
 #Collection of Video Codec Packages to enable the viewing of videos
-apt-get -y install libjpeg-dev libpng-dev libtiff-dev
+apt-get -y install libjpeg-dev libpng-dev libtiff-dev zlib1g-dev
 apt-get -y install libavcodec-dev libavformat-dev libswscale-dev libv4l-dev
 apt-get -y install libxvidcore-dev libx264-dev
 
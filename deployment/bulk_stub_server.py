@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""Stub bulk endpoint for testing pedestrian_tracker -bulk_url.
+
+Accepts POST requests with NDJSON bodies (plain or Elasticsearch _bulk),
+prints a summary of every batch and answers 200. Run with --fail to answer
+503 instead, which makes the tracker spool batches to disk. Run with
+--reject STATUS to answer _bulk requests like Elasticsearch does when some
+documents fail: 200 with "errors":true and STATUS for every third item.
+
+    python3 bulk_stub_server.py [--port 9200] [--fail] [--reject STATUS] [--verbose]
+"""
+import argparse
+import json
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+
+def make_handler(args):
+    class Handler(BaseHTTPRequestHandler):
+        def do_POST(self):
+            length = int(self.headers.get('Content-Length', 0))
+            lines = self.rfile.read(length).decode('utf-8').splitlines()
+            docs = [json.loads(line) for line in lines if line and not line.startswith('{"index"')]
+            print('%s: %d documents' % (self.path, len(docs)), flush=True)
+            if args.verbose:
+                for doc in docs:
+                    print('  ', doc, flush=True)
+            status = 503 if args.fail else 200
+            items = [{'index': {'status': args.reject if args.reject and i % 3 == 2 else 201}}
+                     for i in range(len(docs))]
+            for item in items:
+                if item['index']['status'] >= 300:
+                    item['index']['error'] = {'type': 'stub_error', 'reason': 'rejected by --reject'}
+            errors = any(item['index']['status'] >= 300 for item in items)
+            body = json.dumps({'errors': errors, 'items': items}, separators=(',', ':')).encode('utf-8')
+            self.send_response(status)
+            self.send_header('Content-Type', 'application/json')
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, *unused):
+            pass
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', type=int, default=9200)
+    parser.add_argument('--fail', action='store_true')
+    parser.add_argument('--reject', type=int, default=0)
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+    HTTPServer(('', args.port), make_handler(args)).serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -23,16 +23,20 @@
  */
 
 #include <algorithm>
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <string>
 #include <map>
-#include <sstream>
+#include <thread>
 #include <vector>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/opencv.hpp>
 
 #include "lodepng.h"
 #include "heatmap.h"
+#include <utils/csv_reader.hpp>
+#include <utils/traj_log.hpp>
 
 #include "gray.h"
 #include "Blues.h"
@@ -179,24 +183,134 @@ std::map<std::string, const heatmap_colorscheme_t*> g_schemes = {
     {"YlOrRd_mixed_exp", heatmap_cs_YlOrRd_mixed_exp},
 };
 
-std::vector<int> praise_csv(std::string line) {
-    std::vector<int> result;
-    std::vector<std::string> temp;
-    std::stringstream s_stream(line);
-        while(s_stream.good()) {
-            std::string substr;
-            std::getline(s_stream, substr, ',');
-            temp.push_back(substr);
+// Input rows that were not added to the heatmap.
+struct skipped_rows {
+    size_t invalid = 0;
+    size_t out_of_bounds = 0;
+};
+
+// Feet coordinates (x + width/2, y + height) of a trajectory log row.
+bool feet_from_csv(const CsvReader& row, unsigned int* x, unsigned int* y) {
+    int32_t box_x, box_y, box_w, box_h;
+    if(!row.Int(3, &box_x) || !row.Int(4, &box_y) || !row.Int(5, &box_w) || !row.Int(6, &box_h)) {
+        return false;
+    }
+    *x = box_x + box_w/2;
+    *y = box_y + box_h;
+    return true;
+}
+
+// Without a stamp the point is added as a single pixel, to be spread by
+// convolve_with_stamp.
+void add_feet(heatmap_t* hm, unsigned int x, unsigned int y, const heatmap_stamp_t* stamp, skipped_rows* skipped) {
+    if(x < hm->w && y < hm->h) {
+        if(stamp) {
+            heatmap_add_weighted_point_with_stamp_nomax(hm, x, y, 1.0f, stamp);
+        } else {
+            hm->buf[y*hm->w + x] += 1.0f;
+        }
+    } else {
+        skipped->out_of_bounds++;
+    }
+}
+
+// Adds the rows of the CSV log in [begin, end), which holds whole lines.
+void accumulate_csv(const char* begin, const char* end, heatmap_t* hm, const heatmap_stamp_t* stamp, skipped_rows* skipped) {
+    CsvReader reader(begin, end - begin);
+    unsigned int x, y;
+    while(reader.Next()) {
+        if(feet_from_csv(reader, &x, &y)) {
+            add_feet(hm, x, y, stamp, skipped);
+        } else {
+            skipped->invalid++;
         }
-    try {
-        result.push_back(std::stoi(temp[3]) + std::stoi(temp[5])/2);
-        result.push_back(std::stoi(temp[4]) + std::stoi(temp[6]));
     }
-    catch (std::exception e) {
-        std::cerr << "Error praising input data." << std::endl;
+}
+
+// Adds the rows of the blocks [first, last) of a binary log.
+void accumulate_blocks(const TrajLogReader& reader, size_t first, size_t last, heatmap_t* hm, const heatmap_stamp_t* stamp, skipped_rows* skipped) {
+    std::vector<TrajRow> rows;
+    for(size_t i = first; i < last; i++) {
+        reader.ReadBlock(i, &rows);
+        for(const auto& row : rows) {
+            add_feet(hm, row.x + row.width/2, row.y + row.height, stamp, skipped);
+        }
     }
-    return result;
 }
+
+// Runs work(i, map, skipped) for i in [0, threads) on that many threads. Every
+// thread adds its points to its own map, so the stamps need no locking; the
+// maps are then added up pairwise in parallel into hm and the max is computed
+// once over the sum.
+template<typename Work>
+void accumulate_parallel(heatmap_t* hm, size_t threads, Work work, skipped_rows* skipped) {
+    std::vector<heatmap_t*> maps(threads, hm);
+    std::vector<skipped_rows> skips(threads);
+    for(size_t i = 1; i < threads; i++) {
+        maps[i] = heatmap_new(hm->w, hm->h);
+    }
+
+    std::vector<std::exception_ptr> errors(threads);
+    auto run = [&](size_t i) {
+        try {
+            work(i, maps[i], &skips[i]);
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < threads; i++) {
+        workers.emplace_back(run, i);
+    }
+    run(0);
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    for(size_t step = 1; step < threads; step *= 2) {
+        workers.clear();
+        for(size_t i = 0; i + step < threads; i += 2*step) {
+            workers.emplace_back([&maps, i, step]() { heatmap_add_heatmap(maps[i], maps[i + step]); });
+        }
+        for(auto& worker : workers) {
+            worker.join();
+        }
+    }
+    heatmap_update_max(hm);
+
+    for(size_t i = 0; i < threads; i++) {
+        if(i > 0) {
+            heatmap_free(maps[i]);
+        }
+        skipped->invalid += skips[i].invalid;
+        skipped->out_of_bounds += skips[i].out_of_bounds;
+    }
+    for(const auto& error : errors) {
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// Spreads the points added as single pixels with the stamp. This is one
+// convolution of the whole map instead of one stamp per point; filter2D
+// switches to a DFT for kernels of this size. Pixels outside the map count
+// as empty, so points at the border are clipped as heatmap_add_point does.
+void convolve_with_stamp(heatmap_t* hm, const heatmap_stamp_t* stamp) {
+    cv::Mat points(hm->h, hm->w, CV_32F, hm->buf);
+    cv::Mat kernel(stamp->h, stamp->w, CV_32F, stamp->buf);
+    cv::Mat flipped, heat;
+    // filter2D correlates; the flipped kernel and anchor turn it into the
+    // stamp placement, also for uneven stamps.
+    cv::flip(kernel, flipped, -1);
+    const cv::Point anchor(stamp->w - 1 - stamp->w/2, stamp->h - 1 - stamp->h/2);
+    cv::filter2D(points, heat, CV_32F, flipped, anchor, 0, cv::BORDER_CONSTANT);
+    // The DFT leaves rounding noise around 0 where there are no points.
+    cv::max(heat, 0.0, points);
+    heatmap_update_max(hm);
+}
+
 void blend(cv::Mat background, cv::Mat foreground, float opacity) {
     if(background.empty())
         std::cerr << "Background is empty!" << std::endl;
@@ -236,16 +350,17 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    if(argc < 3 || 6 < argc) {
+    if(argc < 3 || 7 < argc) {
         std::cerr << "Invalid number of arguments!" << std::endl;
         std::cout << "Usage:" << std::endl;
-        std::cout << "  " << argv[0] << " reference.png output.png [STAMP_RADIUS [COLORSCHEME]] < data.csv" << std::endl;
+        std::cout << "  " << argv[0] << " reference.png output.png [STAMP_RADIUS [COLORSCHEME [THREADS [MODE]]]] < data.csv" << std::endl;
         std::cout << std::endl;
         std::cout << "  output.png is the name of the output image file." << std::endl;
         std::cout << std::endl;
         std::cout << "  data.csv should follow output format of pedestrian_tracker and it should contain" << std::endl;
         std::cout << "  coordinates (x, y) as well as (width, height) in " << std::endl;
         std::cout << "  column 4, 5, 6, 7 respectively" << std::endl;
+        std::cout << "  A binary log written with pedestrian_tracker -log_binary is accepted as well." << std::endl;
         std::cout << std::endl;
         std::cout << "  This module calculates feet coordinates from input data using the following formulas:" << std::endl;
         std::cout << "  feet_x = x + width/2 || feet_y = y + height" << std::endl;
@@ -258,6 +373,12 @@ int main(int argc, char* argv[])
         std::cout << "  To get a list of available colorschemes, run" << std::endl;
         std::cout << "  " << argv[0] << " -l" << std::endl;
         std::cout << "  The default colorscheme is Spectral_mixed." << std::endl;
+        std::cout << std::endl;
+        std::cout << "  The points are added on THREADS threads, by default one per CPU core." << std::endl;
+        std::cout << std::endl;
+        std::cout << "  MODE stamp (default) adds the stamp for every point. MODE splat adds every point" << std::endl;
+        std::cout << "  as one pixel and spreads them all with a single convolution, which is much faster" << std::endl;
+        std::cout << "  for large logs and gives the same heatmap up to float rounding." << std::endl;
 
         return 1;
     }
@@ -278,22 +399,58 @@ int main(int argc, char* argv[])
         std::cerr << "Unknown colorscheme. Run " << argv[0] << " -l for a list of valid ones." << std::endl;
         return 1;
     }
-    const heatmap_colorscheme_t* colorscheme = argc == 5 ? g_schemes[argv[4]] : heatmap_cs_default;
+    const heatmap_colorscheme_t* colorscheme = argc >= 5 ? g_schemes[argv[4]] : heatmap_cs_default;
 
-    std::vector<int> praised_result;
-    std::string line;
-    unsigned int x, y;
-    float weight = 1.0f;
-
-    while( std::getline(std::cin, line) ) {
-        praised_result = praise_csv(line);
-        x = praised_result[0];
-        y = praised_result[1];
-        if(x < w && y < h) {
-            heatmap_add_weighted_point_with_stamp(hm, x, y, weight, stamp);
-        } else {
-            std::cerr << "[Warning]: Skipping out-of-bound input coordinate: (" << x << "," << y << ")." << std::endl;
+    size_t threads = argc >= 6 ? std::max(1, atoi(argv[5])) : std::max(1u, std::thread::hardware_concurrency());
+    const std::string mode = argc == 7 ? argv[6] : "stamp";
+    if(mode != "stamp" && mode != "splat") {
+        std::cerr << "Unknown mode " << mode << ". Use stamp or splat." << std::endl;
+        return 1;
+    }
+    // In splat mode the points are added without the stamp.
+    const heatmap_stamp_t* point_stamp = mode == "splat" ? nullptr : stamp;
+    skipped_rows skipped;
+
+    // stdin redirected from a file is mapped, a pipe is read into memory.
+    MappedFile input = MappedFile::FromDescriptor(0);
+    if(TrajLogReader::IsTrajLog(input.data(), input.size())) {
+        // Binary trajectory log (pedestrian_tracker -log_binary).
+        try {
+            TrajLogReader reader(input.data(), input.size());
+            const size_t blocks = reader.blocks().size();
+            threads = std::max<size_t>(1, std::min(threads, blocks));
+            accumulate_parallel(hm, threads, [&](size_t i, heatmap_t* map, skipped_rows* skip) {
+                accumulate_blocks(reader, blocks*i/threads, blocks*(i + 1)/threads, map, point_stamp, skip);
+            }, &skipped);
         }
+        catch (const std::exception& e) {
+            std::cerr << "Error reading binary log: " << e.what() << std::endl;
+            return 1;
+        }
+    } else {
+        // Every thread gets at least 1 MB, split at line ends.
+        const char* data = input.data();
+        const char* end = data + input.size();
+        threads = std::max<size_t>(1, std::min(threads, input.size() >> 20));
+        std::vector<const char*> bounds(threads + 1, end);
+        bounds[0] = data;
+        for(size_t i = 1; i < threads; i++) {
+            const char* p = std::max(bounds[i - 1], data + input.size()*i/threads);
+            const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+            bounds[i] = eol ? eol + 1 : end;
+        }
+        accumulate_parallel(hm, threads, [&](size_t i, heatmap_t* map, skipped_rows* skip) {
+            accumulate_csv(bounds[i], bounds[i + 1], map, point_stamp, skip);
+        }, &skipped);
+    }
+    if(mode == "splat") {
+        convolve_with_stamp(hm, stamp);
+    }
+    if(skipped.invalid > 0) {
+        std::cerr << "[Warning]: Skipped " << skipped.invalid << " invalid input lines." << std::endl;
+    }
+    if(skipped.out_of_bounds > 0) {
+        std::cerr << "[Warning]: Skipped " << skipped.out_of_bounds << " out-of-bound input coordinates." << std::endl;
     }
     heatmap_stamp_free(stamp);
 
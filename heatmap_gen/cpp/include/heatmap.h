@@ -80,6 +80,21 @@ void heatmap_add_weighted_point(heatmap_t* h, unsigned x, unsigned y, float w);
 /* Adds a single weighted point to the heatmap using a given stamp. */
 void heatmap_add_weighted_point_with_stamp(heatmap_t* h, unsigned x, unsigned y, float w, const heatmap_stamp_t* stamp);
 
+/* Like `heatmap_add_weighted_point_with_stamp`, but leaves the heatmap's max
+ * untouched, which makes adding a point several times faster. Call
+ * `heatmap_update_max` once all points have been added.
+ */
+void heatmap_add_weighted_point_with_stamp_nomax(heatmap_t* h, unsigned x, unsigned y, float w, const heatmap_stamp_t* stamp);
+
+/* Adds the heat of `src` to `dst`, pixel by pixel. Both need the same size.
+ * This is how heatmaps accumulated separately (e.g. by several threads) are
+ * combined. The max of `dst` is left untouched.
+ */
+void heatmap_add_heatmap(heatmap_t* dst, const heatmap_t* src);
+
+/* Recomputes the max of the heatmap from all of its pixels and returns it. */
+float heatmap_update_max(heatmap_t* h);
+
 /* Renders an image of the heatmap into the given colorbuf.
  *
  * colorbuf: A buffer large enough to hold 4*heatmap_width*heatmap_height
@@ -164,6 +164,79 @@ void heatmap_add_weighted_point_with_stamp(heatmap_t* h, unsigned x, unsigned y,
     } /* I hate you very much! */
 }
 
+void heatmap_add_weighted_point_with_stamp_nomax(heatmap_t* h, unsigned x, unsigned y, float w, const heatmap_stamp_t* stamp)
+{
+    if(x >= h->w || y >= h->h)
+        return;
+
+    assert(w >= 0.0f);
+
+    {
+        /* Same clipping as in heatmap_add_weighted_point_with_stamp. */
+        const unsigned x0 = x < stamp->w/2 ? (stamp->w/2 - x) : 0;
+        const unsigned y0 = y < stamp->h/2 ? (stamp->h/2 - y) : 0;
+        const unsigned x1 = (x + stamp->w/2) < h->w ? stamp->w : stamp->w/2 + (h->w - x);
+        const unsigned y1 = (y + stamp->h/2) < h->h ? stamp->h : stamp->h/2 + (h->h - y);
+
+        unsigned iy;
+
+        for(iy = y0 ; iy < y1 ; ++iy) {
+            float* __restrict line = h->buf + ((y + iy) - stamp->h/2)*h->w + (x + x0) - stamp->w/2;
+            const float* __restrict stampline = stamp->buf + iy*stamp->w + x0;
+            const unsigned n = x1 - x0;
+
+            /* Without the max there is no dependency between the pixels,
+             * so the compiler can vectorize this loop.
+             */
+            unsigned ix;
+            for(ix = 0 ; ix < n ; ++ix) {
+                line[ix] += stampline[ix] * w;
+            }
+        }
+    }
+}
+
+void heatmap_add_heatmap(heatmap_t* dst, const heatmap_t* src)
+{
+    float* __restrict d = dst->buf;
+    const float* __restrict s = src->buf;
+    const size_t n = (size_t)dst->w*dst->h;
+    size_t i;
+
+    assert(dst->w == src->w && dst->h == src->h);
+
+    for(i = 0 ; i < n ; ++i) {
+        d[i] += s[i];
+    }
+}
+
+float heatmap_update_max(heatmap_t* h)
+{
+    /* Eight independent maxima, so the loop maps onto vector max
+     * instructions instead of a compare and branch per pixel.
+     */
+    float lanes[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    const float* buf = h->buf;
+    const size_t n = (size_t)h->w*h->h;
+    size_t i;
+    unsigned j;
+
+    for(i = 0 ; i + 8 <= n ; i += 8) {
+        for(j = 0 ; j < 8 ; ++j) {
+            lanes[j] = buf[i + j] > lanes[j] ? buf[i + j] : lanes[j];
+        }
+    }
+    for( ; i < n ; ++i) {
+        lanes[0] = buf[i] > lanes[0] ? buf[i] : lanes[0];
+    }
+
+    h->max = lanes[0];
+    for(j = 1 ; j < 8 ; ++j) {
+        h->max = lanes[j] > h->max ? lanes[j] : h->max;
+    }
+    return h->max;
+}
+
 unsigned char* heatmap_render_default_to(const heatmap_t* h, unsigned char* colorbuf)
 {
     return heatmap_render_to(h, heatmap_cs_default, colorbuf);
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <map>
+#include <string>
+#include <thread>
+
+///
+/// \brief The BulkSinkParams struct stores parameters of BulkSink.
+///
+struct BulkSinkParams {
+    std::string url;  ///< http://host[:port]/path of the bulk endpoint.
+
+    std::string people_index;  ///< Index of trajectory rows (Elasticsearch _bulk only).
+    std::string roi_index;     ///< Index of ROI rows (Elasticsearch _bulk only).
+    std::string directions_index;  ///< Index of direction rows (Elasticsearch _bulk only).
+    std::string lines_index;   ///< Index of line-crossing counts (Elasticsearch _bulk only).
+    std::string zones_index;   ///< Index of zone visits (Elasticsearch _bulk only).
+    std::string flows_index;   ///< Index of zone flow counts (Elasticsearch _bulk only).
+    std::string contacts_index;  ///< Index of close contacts (Elasticsearch _bulk only).
+    std::string events_index;  ///< Index of track events (Elasticsearch _bulk only).
+    std::string occupancy_index;  ///< Index of occupancy buckets (Elasticsearch _bulk only).
+
+    size_t batch_size;  ///< Number of documents sent in one request.
+
+    std::chrono::milliseconds flush_interval;  ///< Max time a document waits
+                                               /// for its batch to fill up.
+
+    std::string spool_dir;  ///< Directory batches are kept in while the
+                            /// endpoint is not reachable.
+
+    size_t spool_max_bytes;  ///< Max size of the spool; the oldest batches
+                             /// are dropped beyond it. 0 is unlimited.
+
+    ///
+    /// \brief Constructor that creates default parameters.
+    ///
+    BulkSinkParams();
+};
+
+///
+/// \brief Sends log rows as batched NDJSON to an HTTP bulk endpoint.
+///
+/// Documents are collected by the caller's thread and sent by a dedicated
+/// thread, so a slow or dead endpoint never blocks the caller. If the URL
+/// path ends with "_bulk" the body is an Elasticsearch bulk request (an
+/// index action before every document); otherwise plain NDJSON is posted,
+/// e.g. to the Logstash http input of logstash_AI.conf, with a "type" field
+/// in every document that names its log (the Filebeat tag). Batches that can't be delivered are
+/// written to the spool directory and resent, oldest first, once the
+/// endpoint answers again. When the spool outgrows its limit the oldest
+/// batches are dropped. A spooled batch the endpoint refuses for good
+/// (answered, but not accepted) several times is renamed to "*.failed" so it
+/// does not block the batches behind it.
+///
+/// Elasticsearch answers a bulk request with 200 even if some documents were
+/// rejected, so its response is checked item by item: documents rejected
+/// for a transient reason (429 or 5xx) are spooled and resent, the others
+/// (e.g. mapping errors) are dropped with a warning.
+///
+class BulkSink {
+public:
+    ///
+    /// \brief Kind of a document, selects the target index. In the order of
+    /// LogRecord::Kind.
+    ///
+    enum Kind { kPeople, kRoi, kDirections, kLines, kZones, kFlows, kContacts, kEvents, kOccupancy };
+
+    ///
+    /// \brief Starts the sender thread.
+    /// \param[in] params Sink parameters.
+    ///
+    explicit BulkSink(const BulkSinkParams &params);
+
+    ///
+    /// \brief Stops the sender thread (see Close).
+    ///
+    ~BulkSink();
+
+    ///
+    /// \brief Sends (or spools) the pending documents and stops the thread.
+    ///
+    void Close();
+
+    BulkSink(const BulkSink &) = delete;
+    BulkSink &operator=(const BulkSink &) = delete;
+
+    ///
+    /// \brief Queues documents for sending.
+    /// \param[in] kind Kind of the documents.
+    /// \param[in] docs Newline-terminated JSON documents.
+    /// \param[in] count Number of documents in docs.
+    ///
+    void Add(Kind kind, const std::string &docs, size_t count);
+
+    ///
+    /// \brief Number of documents accepted by the endpoint.
+    ///
+    uint64_t sent() const;
+
+    ///
+    /// \brief Number of documents written to the spool directory.
+    ///
+    uint64_t spooled() const;
+
+    ///
+    /// \brief Number of documents Elasticsearch rejected for good.
+    ///
+    uint64_t rejected() const;
+
+    ///
+    /// \brief Number of queued documents not yet sent or spooled.
+    ///
+    size_t pending() const;
+
+private:
+    void Run();
+    const std::string &Index(Kind kind) const;
+    static const char *Type(Kind kind);
+    bool Post(const std::string &body, std::string *response, int *status);
+    bool Deliver(const std::string &body, std::string *retry, size_t *retry_docs, size_t *rejected);
+    bool SendSpooled();
+    void Spool(const std::string &body);
+    void TrimSpool();
+
+    BulkSinkParams params_;
+    std::string host_;
+    std::string port_;
+    std::string path_;
+    bool es_bulk_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::string body_;        ///< Pending request body.
+    size_t body_docs_;        ///< Number of documents in body_.
+    bool stop_;
+    uint64_t sent_;
+    uint64_t spooled_;
+    uint64_t rejected_;
+    uint64_t spool_seq_;      ///< Sequence number of the next spool file.
+    bool refused_;            ///< The last failed Deliver was answered by the endpoint.
+    std::map<std::string, int> spool_refusals_;  ///< Refusals of each spool file.
+
+    std::chrono::steady_clock::time_point retry_at_;  ///< No requests before this time.
+    std::chrono::milliseconds backoff_;
+
+    std::thread thread_;
+};
@@ -106,6 +106,8 @@ public:
 
     int size() const { return result_size_; }
 
+    cv::Size input_size() const;
+
 private:
     int result_size_;               ///< Length of result
 };
@@ -6,5 +6,8 @@
 namespace config_log_paths{
     const std::string PATHTOCAMCONFIG = "configs/camera_config.txt";
     const std::string PATHTOROICONFIG = "configs/roi_config.txt";
+    const std::string PATHTOLINECONFIG = "configs/line_config.txt";
+    const std::string PATHTOZONECONFIG = "configs/zone_config.txt";
     const std::string PATHTOLOG = "logs/";
+    const std::string PATHTOSPOOL = "logs/spool/";
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "distance_estimate.hpp"
+#include "log_writer.hpp"
+#include "tracker.hpp"
+
+class EventStream;
+
+///
+/// \brief Finished contact of two people closer than the distance threshold.
+///
+struct ContactEvent {
+    int first_id;          ///< Lower track ID as written to the trajectory log.
+    int second_id;         ///< Higher track ID.
+    uint64_t start_time;   ///< Time of the first close frame in ms.
+    uint64_t end_time;     ///< Time of the last close frame in ms.
+    float min_distance;    ///< Closest ground distance in m.
+};
+
+///
+/// \brief Accumulates how long pairs of tracks stay closer than the distance
+/// threshold and reports a contact once it ends.
+///
+/// Pairs are keyed by the log IDs of both tracks. Open contacts are kept in
+/// a list ordered by the time they were last seen close; a pair seen again is
+/// moved to the back, so the contacts that have ended are always at the
+/// front and expiring one costs O(1). A contact survives gaps of up to
+/// max_gap_ms, so a missed detection doesn't split it in two.
+///
+class ContactTracker {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] ground Camera calibration and distance threshold; must be
+    /// configured and outlive the tracker.
+    /// \param[in] max_gap_ms Longest time a pair may be apart within one contact.
+    /// \param[in] min_duration_ms Shorter contacts are not reported.
+    ///
+    ContactTracker(const DistanceEstimate &ground, uint64_t max_gap_ms, uint64_t min_duration_ms);
+
+    ///
+    /// \brief Updates the contacts with the current frame and ends the ones
+    /// that have been apart for longer than the gap.
+    /// \param[in] tracker Tracker after processing the frame.
+    /// \param[in] timestamp Frame time in ms.
+    ///
+    void Update(const PedestrianTracker &tracker, uint64_t timestamp);
+
+    ///
+    /// \brief Ends all open contacts, e.g. at the end of the input.
+    ///
+    void Finish();
+
+    ///
+    /// \brief Takes the contacts finished so far.
+    /// \return Finished contacts.
+    ///
+    std::vector<ContactEvent> TakeEvents();
+
+    ///
+    /// \brief Sets the stream the start and end of every contact are also
+    /// added to, for both tracks.
+    /// \param[in] stream Event stream (may be null); must outlive the tracker.
+    ///
+    void set_event_stream(EventStream *stream) { stream_ = stream; }
+
+    ///
+    /// \brief Number of open contacts.
+    ///
+    size_t size() const { return open_.size(); }
+
+private:
+    struct OpenContact {
+        uint64_t key;
+        ContactEvent event;
+    };
+    using ContactList = std::list<OpenContact>;
+
+    void End(const ContactEvent &event);
+
+    const DistanceEstimate &ground_;
+    uint64_t max_gap_ms_;
+    uint64_t min_duration_ms_;
+    ContactList open_;  ///< Oldest last contact first.
+    std::unordered_map<uint64_t, ContactList::iterator> index_;
+    std::vector<ContactEvent> events_;
+    EventStream *stream_;
+};
+
+///
+/// \brief Queues finished contacts for the contact log.
+/// \param[in] writer Log writer.
+/// \param[in] events Finished contacts.
+///
+void SaveContactLog(AsyncLogWriter &writer, const std::vector<ContactEvent> &events);
@@ -28,6 +28,13 @@ public:
     ///
     virtual cv::Size size() const = 0;
 
+    ///
+    /// \brief Input image size getter.
+    /// \return Size images are resized to before computing the descriptor
+    /// (empty if images of any size are used as is).
+    ///
+    virtual cv::Size input_size() const { return cv::Size(); }
+
     ///
     /// \brief Computes image descriptor.
     /// \param[in] mat Color image.
@@ -75,6 +82,12 @@ public:
     ///
     cv::Size size() const override { return descr_size_; }
 
+    ///
+    /// \brief Returns input image size.
+    /// \return Size of the resized image.
+    ///
+    cv::Size input_size() const override { return descr_size_; }
+
     ///
     /// \brief Computes image descriptor.
     /// \param[in] mat Frame containing the image of interest.
@@ -125,6 +138,14 @@ public:
         return cv::Size(1, handler.size());
     }
 
+    ///
+    /// \brief Input image size getter.
+    /// \return Spatial size of the network input.
+    ///
+    cv::Size input_size() const override {
+        return handler.input_size();
+    }
+
     ///
     /// \brief Computes image descriptor.
     /// \param[in] mat Color image.
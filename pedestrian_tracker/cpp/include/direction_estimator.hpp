@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "core.hpp"
+#include "distance_estimate.hpp"
+#include "log_writer.hpp"
+#include "tracker.hpp"
+#include "utils.hpp"
+
+///
+/// \brief Direction and speed of a finished track.
+///
+struct DirectionEntry {
+    int object_id;            ///< Track ID as written to the trajectory log.
+    uint64_t timestamp;       ///< Time the track started in ms.
+    MoveDirection direction;  ///< Direction from the first to the last position.
+    float speed;              ///< Mean ground speed in m/s, negative if unknown.
+};
+
+///
+/// \brief Estimates the direction and speed of every track while it is
+/// tracked and reports them when the track ends.
+///
+/// Only the first, the last and a sampled ground position are kept per
+/// track, so no log has to be read back.
+///
+class DirectionEstimator {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] ground Camera calibration used for the ground speed; may be
+    /// null, then the speed is not estimated. Must outlive the estimator.
+    ///
+    explicit DirectionEstimator(const DistanceEstimate *ground = nullptr);
+
+    ///
+    /// \brief Updates the tracks with the current frame. Tracks that are no
+    /// longer active are finished.
+    /// \param[in] tracker Tracker after processing the frame.
+    ///
+    void Update(const PedestrianTracker &tracker);
+
+    ///
+    /// \brief Finishes all tracks, e.g. at the end of the input.
+    ///
+    void Finish();
+
+    ///
+    /// \brief Takes the entries of the tracks finished so far.
+    /// \return Finished entries.
+    ///
+    std::vector<DirectionEntry> TakeFinished();
+
+private:
+    struct TrackState {
+        TrackedObject first;
+        TrackedObject last;
+        cv::Point2f sample;    ///< Last sampled ground position (m).
+        uint64_t sample_time;  ///< Time of the sample in ms.
+        float distance;        ///< Ground distance walked up to the sample (m).
+        uint64_t seen;         ///< Last update the track was active in.
+    };
+
+    void FinishTrack(int id, const TrackState &state);
+
+    const DistanceEstimate *ground_;
+    std::unordered_map<int, TrackState> tracks_;
+    std::vector<DirectionEntry> finished_;
+    uint64_t updates_;
+};
+
+///
+/// \brief Queues direction entries for the direction log.
+/// \param[in] writer Log writer.
+/// \param[in] entries Entries of finished tracks.
+///
+void SaveDirectionLog(AsyncLogWriter &writer, const std::vector<DirectionEntry> &entries);
@@ -1,8 +1,15 @@
 #pragma once
 
-#include "core.hpp"
+#include <vector>
 
+#include "core.hpp"
 
+/// \brief two pedestrians closer than the distance threshold
+struct CloseContact {
+    size_t first;    ///< index of the first box, always below second
+    size_t second;   ///< index of the second box
+    float distance;  ///< ground distance in meters
+};
 
 class DistanceEstimate{
     public:
@@ -19,10 +26,32 @@ class DistanceEstimate{
         explicit DistanceEstimate(cv::Mat& video_frame,std::vector<cv::Point2f> config_points,float threshold);
 
         
-        /// \brief draw the line between all detected objects below a THRESHOLD and show the distance between them
+        /// \brief draw the line between all detected objects below a THRESHOLD and show the distance between them.
+        /// groups of three or more people in contact are framed.
         /// \param[in] boxes a list of  detected objects.
         void DrawDistance(const TrackedObjects &boxes);
 
+        /// \brief find all pairs of pedestrians closer than the threshold.
+        /// the ground points are bucketed into a grid with cells of the threshold size,
+        /// so only boxes in neighboring cells are compared and every pair is visited once.
+        /// \param[in] boxes a list of detected objects.
+        /// \return the close pairs, each reported once.
+        std::vector<CloseContact> FindContacts(const TrackedObjects &boxes) const;
+
+        /// \brief group pedestrians connected by close contacts (union-find).
+        /// \param[in] count number of boxes the contacts refer to.
+        /// \param[in] contacts close pairs from FindContacts.
+        /// \return groups of two or more box indices, each sorted.
+        static std::vector<std::vector<size_t>> GroupContacts(size_t count, const std::vector<CloseContact> &contacts);
+
+        /// \brief whether the camera was configured, so ground positions are known
+        bool HasGroundPlane() const;
+
+        /// \brief ground position of a pedestrian in meters
+        /// \param[in] box bounding box of the pedestrian; its bottom middle point is used
+        /// \return position on the top down view, scaled to meters
+        cv::Point2f ToGround(const cv::Rect &box) const;
+
         /// \brief overloading a assignment operator 
         /// \param[in] other a distanceestimate object.
         DistanceEstimate& operator=(const DistanceEstimate &other);
@@ -46,24 +75,15 @@ class DistanceEstimate{
         /// \return the middle point
         cv::Point GetMiddle(const cv::Point2f &point_1, const cv::Point2f &point_2);
 
-        /// \brief scaling point to a top down view perspective
+        /// \brief scaling points to a top down view perspective in one perspectiveTransform call
         /// \param[in] boxes a list of tracked predestrians
-        /// \return the bottom middle points of the detected boxes. points are scaled to top down perspective
-        std::vector<cv::Point2f> GetTransformedPoints(const TrackedObjects &boxes);
-	
-        /// \brief estimate real distance in meter between two points
-        /// \param[in] point_1 coordinate of the first point
-        /// \param[in] point_2 coordinate of the second point
-        /// \param[in] distance_w scaled vertical distance from perspective transform
-        /// \param[in] distance_h scaled horizontal distance from perspective transform
-        /// \return actual distance between two points
-        float EstimateRealDist(const cv::Point2f &point_1, const cv::Point2f &point_2, const float &distance_w, const float &distance_h) const;
-        
-        /// \brief estimate distance between all detected objects
-        /// \param[in] detected_obj a list of bottom middle points of all detected boxes. points are scaled to top down perspective
-        /// \param[in] boxes a list of detected boxes
-        /// \return a list of pairs of detected objects along with the distance below a THRESHOLD
-        std::vector<std::pair<TrackedObjects, float>> EstimateDistAllObj(const std::vector<cv::Point2f> &detected_pts,const TrackedObjects &boxes);
+        /// \return the bottom middle points of the detected boxes on the top down view, in meters
+        std::vector<cv::Point2f> GetTransformedPoints(const TrackedObjects &boxes) const;
+
+        /// \brief scale a point on the top down view to meters (150cm reference)
+        /// \param[in] warped point after the perspective transformation
+        /// \return the point in meters
+        cv::Point2f ToMeters(const cv::Point2f &warped) const;
 
 
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "log_writer.hpp"
+#include "tracker.hpp"
+
+///
+/// \brief Compact summary of a track's trajectory so far.
+///
+struct TrackSummary {
+    cv::Point2f first;    ///< Bottom point of the first box.
+    cv::Point2f last;     ///< Bottom point of the last box.
+    uint64_t start_time;  ///< Time of the first box in ms.
+    uint64_t last_time;   ///< Time of the last box in ms.
+    uint32_t positions;   ///< Number of boxes.
+    float path;           ///< Length of the walked path in pixels.
+};
+
+///
+/// \brief Event in the life of a track.
+///
+struct TrackEvent {
+    enum Type : uint8_t {
+        kTrackStart,    ///< Track became valid.
+        kTrackEnd,      ///< Track is no longer active.
+        kZoneEnter,     ///< Track entered a zone (other: zone index).
+        kZoneExit,      ///< Track left a zone (other: zone index).
+        kLineIn,        ///< Track crossed a line to its right side (other: line index).
+        kLineOut,       ///< Track crossed a line to its left side (other: line index).
+        kContactStart,  ///< Track came closer than -th to another (other: its ID).
+        kContactEnd     ///< Contact ended (other: ID of the other track).
+    };
+
+    Type type;
+    int object_id;         ///< Track ID as written to the trajectory log.
+    int other;             ///< Zone, line or other track, -1 if none.
+    uint64_t timestamp;    ///< Time of the event in ms.
+    TrackSummary summary;  ///< Trajectory of the track up to the event.
+};
+
+///
+/// \brief Name of an event type as written to the event log.
+///
+const char *TrackEventName(TrackEvent::Type type);
+
+///
+/// \brief Collects the events of all tracks into one stream, as an
+/// alternative to logging every track position of every frame.
+///
+/// Track starts and ends and the trajectory summaries come from the tracker;
+/// zone, line and contact events are added by the ZoneTracker, LineCounter
+/// and ContactTracker the stream is set on. Events of a log ID the stream
+/// does not know yet (e.g. line crossings counted by the tracker on the
+/// frame the track becomes valid) are held until the next Update starts the
+/// track; events of tracks that never start are dropped.
+///
+class EventStream {
+public:
+    EventStream();
+
+    ///
+    /// \brief Starts new tracks and updates the summaries with the current
+    /// frame, then adds the held events of the new tracks. Tracks that are
+    /// no longer active are ended by the next TakeEvents, so their zone exits
+    /// and contact ends come first.
+    /// \param[in] tracker Tracker after processing the frame.
+    ///
+    void Update(const PedestrianTracker &tracker);
+
+    ///
+    /// \brief Adds an event of a track.
+    /// \param[in] type Event type.
+    /// \param[in] object_id Log ID of the track.
+    /// \param[in] other Zone, line or other track.
+    /// \param[in] timestamp Time of the event in ms.
+    ///
+    void Add(TrackEvent::Type type, int object_id, int other, uint64_t timestamp);
+
+    ///
+    /// \brief Ends all tracks, e.g. at the end of the input.
+    ///
+    void Finish();
+
+    ///
+    /// \brief Takes the events so far, ending the tracks that left.
+    /// \return Events in the order they were added.
+    ///
+    std::vector<TrackEvent> TakeEvents();
+
+private:
+    struct TrackState {
+        TrackSummary summary;
+        uint64_t seen;  ///< Last update the track was active in.
+        bool ended;
+    };
+
+    std::unordered_map<int, TrackState> tracks_;
+    std::vector<int> ended_;
+    std::vector<TrackEvent> events_;
+    std::vector<TrackEvent> held_;  ///< Events of tracks not started yet.
+    uint64_t updates_;
+};
+
+///
+/// \brief Queues track events for the event log.
+/// \param[in] writer Log writer.
+/// \param[in] events Events.
+///
+void SaveEventLog(AsyncLogWriter &writer, const std::vector<TrackEvent> &events);
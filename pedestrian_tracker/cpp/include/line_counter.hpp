@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "log_writer.hpp"
+
+class EventStream;
+
+///
+/// \brief Virtual counting line from a to b in image coordinates.
+///
+/// A step that crosses the line to its right-hand side (as seen on the
+/// image when looking from a to b) counts as "in", the opposite step as
+/// "out". For a line drawn left to right, walking down the image is "in".
+///
+struct CountingLine {
+    cv::Point2f a;
+    cv::Point2f b;
+};
+
+///
+/// \brief In/out counts of one line in one time bucket.
+///
+struct LineCount {
+    uint64_t bucket_start;  ///< Start of the bucket in ms.
+    int line;               ///< Index of the line in the config.
+    uint32_t in;            ///< Crossings to the right-hand side.
+    uint32_t out;           ///< Crossings to the left-hand side.
+};
+
+///
+/// \brief Counts line crossings of track steps, aggregated per time bucket.
+///
+/// The tracker passes the step of every valid track it extends (bottom point
+/// of the previous box to the bottom point of the new one); each step costs
+/// one segment intersection test per line. Buckets are aligned to multiples of
+/// the bucket length and every line gets a row per bucket that had frames,
+/// also when nothing crossed it.
+///
+class LineCounter {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] lines Counting lines.
+    /// \param[in] bucket_ms Length of a time bucket in ms.
+    ///
+    LineCounter(const std::vector<CountingLine> &lines, uint64_t bucket_ms);
+
+    ///
+    /// \brief Starts a new bucket if the time has passed the current one.
+    /// \param[in] timestamp Frame time in ms.
+    ///
+    void Advance(uint64_t timestamp);
+
+    ///
+    /// \brief Counts the crossings of one track step.
+    /// \param[in] from Previous position of the track.
+    /// \param[in] to Current position of the track.
+    /// \param[in] object_id Log ID of the track, for the event stream.
+    /// \param[in] timestamp Time of the step in ms, for the event stream.
+    ///
+    void Step(const cv::Point2f &from, const cv::Point2f &to, int object_id = -1, uint64_t timestamp = 0);
+
+    ///
+    /// \brief Sets the stream crossings are also added to as events.
+    /// \param[in] stream Event stream (may be null); must outlive the counter.
+    ///
+    void set_event_stream(EventStream *stream) { stream_ = stream; }
+
+    ///
+    /// \brief Takes the counts of the finished buckets.
+    /// \param[in] flush Also take the current bucket (e.g. at the end of input).
+    /// \return Counts ordered by bucket and line.
+    ///
+    std::vector<LineCount> TakeCounts(bool flush = false);
+
+    ///
+    /// \brief Draws the lines with their total counts.
+    /// \param[in,out] frame Colored image (CV_8UC3).
+    ///
+    void Draw(cv::Mat *frame) const;
+
+    ///
+    /// \brief Lines getter.
+    /// \return Counting lines.
+    ///
+    const std::vector<CountingLine> &lines() const { return lines_; }
+
+    ///
+    /// \brief Crossings counted since the start.
+    /// \param[in] line Index of the line.
+    /// \return Total in and out counts of the line.
+    ///
+    std::pair<uint64_t, uint64_t> total(size_t line) const { return totals_[line]; }
+
+private:
+    void CloseBucket();
+
+    std::vector<CountingLine> lines_;
+    uint64_t bucket_ms_;
+    uint64_t bucket_start_;  ///< Start of the current bucket.
+    bool bucket_open_;       ///< A frame has been seen since the last flush.
+    std::vector<LineCount> current_;
+    std::vector<LineCount> finished_;
+    std::vector<std::pair<uint64_t, uint64_t>> totals_;
+    EventStream *stream_;
+};
+
+///
+/// \brief Reads counting lines from a config file with one "x y" point per
+/// row, two consecutive points per line.
+/// \param[in] path Path to the config file.
+/// \return Counting lines.
+///
+std::vector<CountingLine> ReadLineConfig(const std::string &path);
+
+///
+/// \brief Queues line counts for the line-crossing log.
+/// \param[in] writer Log writer.
+/// \param[in] counts Counts of finished buckets.
+///
+void SaveLineCounts(AsyncLogWriter &writer, const std::vector<LineCount> &counts);
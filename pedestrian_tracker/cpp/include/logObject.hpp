@@ -6,6 +6,8 @@
 #include <sstream>      // std::stringstream
 #include <iostream>
 #include <fstream>
+#include <utils/csv_reader.hpp>
+#include <utils/traj_log.hpp>
 
 class LogInformation
 {
@@ -20,9 +22,6 @@ class LogInformation
     //0.931894, (Confidence)
     //New Demo Location 3 (Location)
 
-    private:
-    std::string segment;        ///< used to identify each log value
-
     public:
     std::string frameNumber;    ///< the frame number
     std::string dateTime;       ///< time of the of the logging
@@ -32,10 +31,12 @@ class LogInformation
     int y_Location;             ///< the y chord top left corner of the user identified
     int x_box;                  ///< the width of the box drawn around the person for the given frame
     int y_box;                  ///< the height of the box drawn around the person for the given frame
-    int confidence;             ///< the confidence interval of the identification for the given frame
+    float confidence;           ///< the confidence interval of the identification for the given frame
     int uniqueID;               ///< pedestrain unique id
     //Split Log into relivant fields
-    LogInformation(std::stringstream &log);
+    LogInformation(const CsvReader &row);
+    //Take the fields from a row of the binary log
+    LogInformation(const TrajRow &row, const std::string &location);
 
 
 };
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <utils/traj_log.hpp>
+
+#include "bulk_sink.hpp"
+#include "spsc_queue.hpp"
+
+///
+/// \brief Rotation policy of a log file. A zero limit is not checked.
+///
+struct LogRotation {
+    size_t max_bytes;              ///< Max size of a segment in bytes.
+    std::chrono::seconds max_age;  ///< Max time a segment is written to.
+
+    LogRotation() : max_bytes(0), max_age(0) {}
+
+    bool enabled() const { return max_bytes > 0 || max_age.count() > 0; }
+};
+
+///
+/// \brief Append-only log file writer.
+///
+/// The file is truncated once when the writer is created (unless asked to
+/// keep its content) and then only appended to, so readers tailing it
+/// (e.g. Filebeat) never see it shrink. Rows are collected in memory and
+/// written in large blocks; buffered rows are also written and synced to
+/// disk when the sync interval has passed.
+///
+/// With rotation enabled the owner checks RotationDue between rows and calls
+/// Rotate, which renames the file to a timestamped segment next to it
+/// ("name-peopletracker.csv" -> "name-peopletracker-20210823-133727.csv")
+/// and starts a new one under the original name.
+///
+class LogFileWriter {
+public:
+    ///
+    /// \brief Opens the log file.
+    /// \param[in] path Path to the log file.
+    /// \param[in] sync_interval Max time rows stay buffered before they are
+    /// written and fsync'ed.
+    /// \param[in] block_size Size of the write buffer in bytes.
+    /// \param[in] truncate Discard the existing content of the file.
+    /// \param[in] rotation Rotation policy.
+    ///
+    LogFileWriter(const std::string &path,
+                  std::chrono::milliseconds sync_interval = std::chrono::seconds(10),
+                  size_t block_size = 1 << 20,
+                  bool truncate = true,
+                  const LogRotation &rotation = LogRotation());
+
+    ///
+    /// \brief Writes buffered rows, syncs and closes the file.
+    ///
+    ~LogFileWriter();
+
+    LogFileWriter(const LogFileWriter &) = delete;
+    LogFileWriter &operator=(const LogFileWriter &) = delete;
+
+    ///
+    /// \brief Appends complete rows to the log.
+    /// \param[in] rows Newline-terminated rows.
+    ///
+    void Write(const std::string &rows);
+
+    ///
+    /// \brief Writes buffered rows to the file and syncs it to disk.
+    ///
+    void Flush();
+
+    ///
+    /// \brief Checks if the current segment has reached the rotation limits.
+    ///
+    bool RotationDue() const;
+
+    ///
+    /// \brief Closes the current segment and starts a new one. On failure
+    /// the current segment stays open and nothing is lost.
+    /// \param[in] last_rows Rows appended to the closed segment only.
+    /// \return Path the closed segment was renamed to.
+    ///
+    std::string Rotate(const std::string &last_rows = std::string());
+
+    ///
+    /// \brief Path getter.
+    /// \return Path to the log file.
+    ///
+    const std::string &path() const { return path_; }
+
+    ///
+    /// \brief Size of the current segment including buffered rows.
+    /// \return Number of bytes in the segment.
+    ///
+    size_t size() const { return segment_bytes_ + buffer_.size(); }
+
+    ///
+    /// \brief Bytes that reached the file.
+    /// \return Number of bytes written to all segments.
+    ///
+    size_t bytes_written() const { return bytes_written_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void Open(bool truncate);
+    void WriteBuffer();
+
+    std::string path_;
+    int fd_;
+    std::string buffer_;
+    size_t block_size_;
+    std::chrono::milliseconds sync_interval_;
+    Clock::time_point last_sync_;
+    size_t bytes_written_;
+    LogRotation rotation_;
+    Clock::time_point segment_start_;
+    size_t segment_bytes_;
+};
+
+///
+/// \brief Gzip-compresses closed log segments on a background thread.
+///
+/// A segment "name.csv" is replaced by "name.csv.gz", which no longer matches
+/// the "*.csv" globs of Filebeat. Filebeat keeps reading a renamed file until
+/// it has been inactive for close_inactive, so a segment is only compressed
+/// once the delay has passed since it was queued.
+///
+class LogCompressor {
+public:
+    ///
+    /// \brief Starts the compressor thread.
+    /// \param[in] delay Time a segment stays uncompressed after it is queued.
+    ///
+    explicit LogCompressor(std::chrono::seconds delay = std::chrono::minutes(10));
+
+    ///
+    /// \brief Compresses the segments whose delay has passed and stops the
+    /// thread. Later segments are left uncompressed.
+    ///
+    ~LogCompressor();
+
+    LogCompressor(const LogCompressor &) = delete;
+    LogCompressor &operator=(const LogCompressor &) = delete;
+
+    ///
+    /// \brief Queues a file for compression.
+    /// \param[in] path Path to the file.
+    ///
+    void Compress(const std::string &path);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Segment {
+        std::string path;
+        Clock::time_point due;  ///< Time the segment may be compressed.
+    };
+
+    void Run();
+
+    std::chrono::seconds delay_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Segment> queue_;
+    bool stop_;
+    std::thread thread_;
+};
+
+///
+/// \brief Compact record of one log row, formatted by the writer thread.
+///
+/// Every log has its own payload type; kind tells which member of the union
+/// is set.
+///
+struct LogRecord {
+    enum Kind : uint8_t {
+        kTrajectory,  ///< Row of the trajectory log.
+        kRoi,         ///< Row of the ROI (time of stay) log.
+        kDirection,   ///< Row of the direction log.
+        kLineCount,   ///< Row of the line-crossing log.
+        kZone,        ///< Row of the zone log.
+        kFlow,        ///< Row of the zone flow (origin/destination) log.
+        kContact,     ///< Row of the close contact log.
+        kEvent,       ///< Row of the track event log.
+        kOccupancy,   ///< Row of the occupancy log.
+        kKindCount    ///< Number of kinds.
+    };
+
+    struct Trajectory {
+        int32_t frame_idx;  ///< Frame index.
+        int32_t object_id;  ///< Object ID.
+        int32_t x;          ///< Bounding box.
+        int32_t y;
+        int32_t width;
+        int32_t height;
+        float confidence;   ///< Detection confidence.
+    };
+
+    struct Roi {
+        int32_t object_id;  ///< Object ID.
+        int32_t stay_ms;    ///< Time of stay in ms.
+    };
+
+    struct Direction {
+        int32_t object_id;  ///< Object ID.
+        uint8_t direction;  ///< MoveDirection.
+        float speed;        ///< Ground speed in m/s, negative if unknown.
+    };
+
+    struct LineCrossings {
+        int32_t line;  ///< Index of the line.
+        uint32_t in;   ///< Crossings to the right-hand side.
+        uint32_t out;  ///< Crossings to the left-hand side.
+    };
+
+    struct ZoneVisit {
+        int32_t object_id;  ///< Object ID.
+        int32_t zone;       ///< Index of the zone.
+        int32_t stay_ms;    ///< Time in the zone in ms.
+    };
+
+    struct ZoneFlow {
+        int32_t origin;       ///< Index of the first zone.
+        int32_t destination;  ///< Index of the last zone.
+        uint32_t count;       ///< Number of people.
+    };
+
+    struct Contact {
+        int32_t first_id;      ///< Lower object ID.
+        int32_t second_id;     ///< Higher object ID.
+        int32_t duration_ms;   ///< Duration of the contact in ms.
+        float min_distance;    ///< Closest distance in m.
+    };
+
+    struct Event {
+        uint8_t type;        ///< TrackEvent::Type.
+        int32_t object_id;   ///< Object ID.
+        int32_t other;       ///< Zone, line or other object ID, -1 if none.
+        int32_t first_x;     ///< First position of the track.
+        int32_t first_y;
+        int32_t last_x;      ///< Last position of the track.
+        int32_t last_y;
+        int32_t age_ms;      ///< Age of the track in ms.
+        int32_t positions;   ///< Number of positions of the track.
+        float path;          ///< Path length in pixels.
+    };
+
+    struct Occupancy {
+        int32_t zone;       ///< Index of the zone, -1 for the whole frame.
+        uint32_t length_s;  ///< Length of the bucket in seconds.
+        float average;      ///< Mean number of people.
+        uint32_t peak;      ///< Max number of people.
+        uint32_t unique;    ///< Number of different people.
+    };
+
+    uint8_t kind;        ///< Log the record belongs to.
+    uint64_t timestamp;  ///< Detection time, time of entering the ROI or zone, time of the
+                         /// event, start of the time bucket or the contact in ms.
+    union {
+        Trajectory trajectory;
+        Roi roi;
+        Direction direction;
+        LineCrossings lines;
+        ZoneVisit zone;
+        ZoneFlow flow;
+        Contact contact;
+        Event event;
+        Occupancy occupancy;
+    };
+};
+
+///
+/// \brief Log files of an AsyncLogWriter, indexed by LogRecord::Kind. Null
+/// entries are not written.
+///
+typedef std::array<std::unique_ptr<LogFileWriter>, LogRecord::kKindCount> LogFiles;
+
+///
+/// \brief Writes logs on a dedicated thread.
+///
+/// The frame thread only converts log entries to LogRecords and enqueues
+/// them into a bounded single-producer/single-consumer queue; formatting
+/// and file I/O happen on the writer thread. When the queue is full the
+/// record is dropped instead of blocking the producer. Rotated segments are
+/// handed to a LogCompressor.
+///
+class AsyncLogWriter {
+public:
+    ///
+    /// \brief Starts the writer thread.
+    /// \param[in] logs Writer of every log.
+    /// \param[in] location Location written to every row.
+    /// \param[in] uuid Run identifier written to every trajectory row.
+    /// \param[in] capacity Queue capacity in records.
+    /// \param[in] binary Write the trajectory log in the binary format
+    /// (see TrajLogEncoder) instead of CSV.
+    /// \param[in] sink Bulk endpoint all rows are also sent to (may be null).
+    /// \param[in] compress_delay Time a rotated segment stays uncompressed.
+    ///
+    AsyncLogWriter(LogFiles logs,
+                   const std::string &location,
+                   const std::string &uuid,
+                   size_t capacity = 1 << 16,
+                   bool binary = false,
+                   std::unique_ptr<BulkSink> sink = nullptr,
+                   std::chrono::seconds compress_delay = std::chrono::minutes(10));
+
+    ///
+    /// \brief Stops the writer thread (see Close).
+    ///
+    ~AsyncLogWriter();
+
+    AsyncLogWriter(const AsyncLogWriter &) = delete;
+    AsyncLogWriter &operator=(const AsyncLogWriter &) = delete;
+
+    ///
+    /// \brief Sets the names written for zone indices. Must be called before
+    /// the first zone, flow or occupancy record is pushed.
+    /// \param[in] names Zone names in index order.
+    ///
+    void SetZoneNames(const std::vector<std::string> &names) { zone_names_ = names; }
+
+    ///
+    /// \brief Enqueues a record. Never blocks.
+    /// \param[in] record Record to write.
+    /// \return false if the queue was full and the record was dropped.
+    ///
+    bool Push(const LogRecord &record);
+
+    ///
+    /// \brief Writes all queued records, flushes the files and stops the
+    /// writer thread. Rethrows an error that happened on the writer thread.
+    ///
+    void Close();
+
+    ///
+    /// \brief Max number of records the queue has held at once.
+    ///
+    size_t high_water_mark() const { return high_water_mark_; }
+
+    ///
+    /// \brief Number of records dropped because the queue was full.
+    ///
+    size_t dropped() const { return dropped_; }
+
+    ///
+    /// \brief Queue capacity in records.
+    ///
+    size_t capacity() const { return queue_.capacity(); }
+
+    ///
+    /// \brief Number of records waiting for the writer thread.
+    ///
+    size_t queue_depth() const { return queue_.size(); }
+
+    ///
+    /// \brief Bytes written to the trajectory log. Valid after Close.
+    ///
+    size_t trajectory_bytes() const {
+        const LogFileWriter *log = logs_[LogRecord::kTrajectory].get();
+        return log ? log->bytes_written() : 0;
+    }
+
+    ///
+    /// \brief Bulk sink getter.
+    /// \return Sink rows are sent to, null if there is none.
+    ///
+    const BulkSink *sink() const { return sink_.get(); }
+
+private:
+    void Run();
+    void Format(const LogRecord &r, TrajLogEncoder *encoder, std::string *row, std::string *doc) const;
+    std::string ZoneName(int zone) const;
+
+    SpscQueue<LogRecord> queue_;
+    LogFiles logs_;
+    std::unique_ptr<BulkSink> sink_;
+    std::vector<std::string> zone_names_;
+    TrajLogHeader header_;
+    bool binary_;
+    std::atomic<bool> stop_;
+    size_t high_water_mark_;
+    size_t dropped_;
+    std::exception_ptr error_;
+    LogCompressor compressor_;
+    std::thread thread_;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+///
+/// \brief Latency histogram with fixed Prometheus-style buckets.
+///
+/// Observe is lock-free, so it can be called from the frame thread while the
+/// histogram is rendered by the metrics server thread.
+///
+class LatencyHistogram {
+public:
+    static const int kBucketsNum = 12;
+
+    LatencyHistogram();
+
+    ///
+    /// \brief Adds a measurement.
+    /// \param[in] latency Measured latency.
+    ///
+    void Observe(std::chrono::steady_clock::duration latency);
+
+    ///
+    /// \brief Renders the histogram in the Prometheus text format.
+    /// \param[in] name Metric name.
+    /// \param[in] labels Labels without braces, e.g. stage="detect".
+    /// \param[out] out Buffer the lines are appended to.
+    ///
+    void Render(const std::string &name, const std::string &labels, std::string *out) const;
+
+private:
+    std::atomic<uint64_t> counts_[kBucketsNum + 1];  ///< Last one is +Inf.
+    std::atomic<uint64_t> sum_ns_;
+};
+
+///
+/// \brief Values exported by the demo on the /metrics endpoint.
+///
+/// The frame thread updates them, the metrics server reads them.
+///
+struct TrackerMetrics {
+    enum Stage { kCapture = 0, kDetect, kTrack, kReid, kDraw, kEncode, kLog, kStagesNum };
+
+    LatencyHistogram stages[kStagesNum];  ///< Per-frame latency of each stage.
+
+    std::atomic<uint64_t> frames;          ///< Processed frames.
+    std::atomic<double> fps;               ///< Frames per second over the last second.
+    std::atomic<uint64_t> active_tracks;   ///< Tracks drawn on the last frame.
+    std::atomic<uint64_t> reid_calls;      ///< Reid descriptor computations.
+    std::atomic<double> reid_per_sec;      ///< Reid computations per second over the last second.
+    std::atomic<uint64_t> log_queue_depth;       ///< Records waiting for the log writer.
+    std::atomic<uint64_t> log_queue_high_water;  ///< Max records the log queue has held.
+    std::atomic<uint64_t> log_dropped;           ///< Records dropped because the log queue was full.
+    std::atomic<uint64_t> bulk_pending;          ///< Documents waiting for the bulk endpoint.
+
+    TrackerMetrics();
+
+    ///
+    /// \brief Renders all metrics in the Prometheus text format.
+    ///
+    std::string Render() const;
+
+    ///
+    /// \brief Name of a stage used as the label value.
+    ///
+    static const char *StageName(Stage stage);
+};
+
+///
+/// \brief Minimal HTTP server answering GET /metrics on its own thread.
+///
+class MetricsServer {
+public:
+    ///
+    /// \brief Starts listening.
+    /// \param[in] metrics Metrics to serve; must outlive the server.
+    /// \param[in] port TCP port.
+    ///
+    MetricsServer(const TrackerMetrics &metrics, int port);
+
+    ///
+    /// \brief Stops the server thread.
+    ///
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+private:
+    void Run();
+    void Serve(int fd);
+
+    const TrackerMetrics &metrics_;
+    int listen_fd_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+};
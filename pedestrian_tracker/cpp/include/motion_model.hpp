@@ -0,0 +1,73 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+///
+/// \brief Constant-velocity Kalman filter over a bounding box.
+///
+/// Center, width and height are filtered as four independent
+/// (position, velocity) pairs, so both the predict and the update step
+/// are O(1) and need no history of the track. Noise is scaled by the box
+/// height, which keeps the filter insensitive to the distance from camera.
+/// Time is measured in frames.
+///
+class KalmanBoxFilter {
+public:
+    ///
+    /// \brief Default constructor. The filter is not initialized.
+    ///
+    KalmanBoxFilter();
+
+    ///
+    /// \brief Constructor that initializes the filter with the first box.
+    /// \param[in] rect First observed bounding box.
+    /// \param[in] frame_idx Frame index of the observation.
+    ///
+    KalmanBoxFilter(const cv::Rect &rect, int frame_idx);
+
+    ///
+    /// \brief Resets the filter to the given box with zero velocity.
+    /// \param[in] rect Observed bounding box.
+    /// \param[in] frame_idx Frame index of the observation.
+    ///
+    void Init(const cv::Rect &rect, int frame_idx);
+
+    ///
+    /// \brief Propagates the state to the frame of the new observation and
+    /// corrects it with the observed box.
+    /// \param[in] rect Observed bounding box.
+    /// \param[in] frame_idx Frame index of the observation.
+    ///
+    void Update(const cv::Rect &rect, int frame_idx);
+
+    ///
+    /// \brief Returns the expected bounding box a number of frames after the
+    /// last observation. The state of the filter is not changed.
+    /// \param[in] steps Number of frames after the last observation.
+    /// \return Predicted bounding box.
+    ///
+    cv::Rect Predict(size_t steps) const;
+
+    ///
+    /// \brief Returns true if the filter has received at least one box.
+    ///
+    bool initialized() const { return frame_idx_ >= 0; }
+
+private:
+    struct Axis {
+        float pos;  ///< Position (center coordinate or size).
+        float vel;  ///< Velocity per frame.
+        float p00;  ///< Position variance.
+        float p01;  ///< Position-velocity covariance.
+        float p11;  ///< Velocity variance.
+
+        void Init(float value, float pos_std, float vel_std);
+        void Predict(float dt, float pos_std, float vel_std);
+        void Correct(float value, float meas_std);
+    };
+
+    enum { kCenterX = 0, kCenterY, kWidth, kHeight, kAxesNum };
+
+    Axis axes_[kAxesNum];  ///< Filtered box parameters.
+    int frame_idx_;        ///< Frame index of the last observation (-1 if N/A).
+};
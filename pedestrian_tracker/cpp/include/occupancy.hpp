@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "log_writer.hpp"
+#include "tracker.hpp"
+#include "zone_tracker.hpp"
+
+///
+/// \brief Occupancy of the frame or of a zone in one time bucket.
+///
+struct OccupancyBucket {
+    uint64_t start;     ///< Start of the bucket in ms.
+    uint32_t length_s;  ///< Length of the bucket in seconds (1, 60 or 3600).
+    int zone;           ///< Index of the zone, -1 for the whole frame.
+    float average;      ///< Mean number of people over the frames of the bucket.
+    uint32_t peak;      ///< Max number of people in one frame.
+    uint32_t unique;    ///< Number of different people seen.
+};
+
+///
+/// \brief Counts the people in the frame and in every zone and rolls the
+/// counts up into 1 s, 1 min and 1 h buckets.
+///
+/// Only the current second is updated per frame; when a bucket ends it is
+/// reported and merged into the bucket of the next level, so a minute is
+/// built from its seconds and an hour from its minutes. Buckets start at full
+/// seconds, minutes and hours of the local time, which is the time the
+/// occupancy log prints, and every bucket that had frames is
+/// reported, also when nobody was there. People are the valid tracks that
+/// were detected in the frame, counted by their log IDs.
+///
+class OccupancyCounter {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] zones Zone map of the per-zone counts (may be null); must
+    /// outlive the counter.
+    ///
+    explicit OccupancyCounter(const ZoneMap *zones = nullptr);
+
+    ///
+    /// \brief Adds the current frame.
+    /// \param[in] tracker Tracker after processing the frame.
+    /// \param[in] timestamp Frame time in ms.
+    ///
+    void Update(const PedestrianTracker &tracker, uint64_t timestamp);
+
+    ///
+    /// \brief Takes the buckets that have ended.
+    /// \param[in] flush Also end the current buckets (e.g. at the end of input).
+    /// \return Buckets, each level after the levels below it.
+    ///
+    std::vector<OccupancyBucket> TakeBuckets(bool flush = false);
+
+private:
+    struct Stats {
+        uint32_t frames;
+        uint64_t sum;
+        uint32_t peak;
+        std::unordered_set<int> ids;
+    };
+
+    struct Level {
+        uint64_t length_ms;
+        uint64_t start;
+        bool open;
+        std::vector<Stats> stats;  ///< Whole frame first, then one per zone.
+    };
+
+    void Advance(uint64_t timestamp);
+    void Close(size_t level);
+
+    const ZoneMap *zones_;
+    std::vector<Level> levels_;
+    std::vector<uint32_t> counts_;  ///< People per stats index in the current frame.
+    std::vector<OccupancyBucket> finished_;
+};
+
+///
+/// \brief Queues occupancy buckets for the occupancy log.
+/// \param[in] writer Log writer.
+/// \param[in] buckets Finished buckets.
+///
+void SaveOccupancyLog(AsyncLogWriter &writer, const std::vector<OccupancyBucket> &buckets);
@@ -42,10 +42,60 @@ static const char output_log_message[] = "Optional. The file name to write outpu
                                           "The format of the log file is compatible with MOTChallenge format.";
 static const char location_message[] = "Required for output log file.";
 static const char utilization_monitors_message[] = "Optional. List of monitors to show initially.";
-static const char re_configuration_message[] ="Optional. 'cam' for re-calibrate camera or 'roi' for re-config the region of interest.";
+static const char re_configuration_message[] ="Optional. 'cam' for re-calibrate camera, 'roi' for re-config the region of interest "
+                                              "or 'line' for re-config the counting line.";
 static const char configuration_message[] = "Optional.Threshold for distance estimation";
 static const char output_a_log_message[] ="Optional. The file name to write extra log. Containing time of stay in ROI";
 static const char stream_message[]="Optional. Stream the feed to localhost:8080";
+static const char log_sync_message[] = "Optional. Interval in seconds after which buffered log rows are written and synced to disk. "
+                                       "Default value is 10.";
+static const char log_queue_message[] = "Optional. Capacity of the queue of log rows waiting for the log writer thread. "
+                                        "Rows are dropped when it is full. Default value is 65536.";
+static const char log_rotate_mb_message[] = "Optional. Start a new log file when the current one reaches the given size in MB. "
+                                            "Closed files are renamed with a timestamp and gzip-compressed later "
+                                            "(see -log_compress_min). 0 disables it (default).";
+static const char log_rotate_min_message[] = "Optional. Start a new log file every given number of minutes. 0 disables it (default).";
+static const char log_compress_min_message[] = "Optional. Minutes a closed log file stays uncompressed, so Filebeat can "
+                                               "finish reading it; keep it above the close_inactive of Filebeat "
+                                               "(5 minutes by default). Default value is 10.";
+static const char bulk_url_message[] = "Optional. Send log rows as batched NDJSON to this HTTP endpoint, "
+                                       "e.g. http://localhost:9200/_bulk (Elasticsearch) or a Logstash http input. "
+                                       "Batches are spooled to logs/spool/ while the endpoint is down.";
+static const char bulk_batch_message[] = "Optional. Number of log rows sent in one bulk request. Default value is 500.";
+static const char bulk_flush_message[] = "Optional. Max time in seconds a log row waits before it is sent to the bulk endpoint. "
+                                         "Default value is 5.";
+static const char bulk_spool_mb_message[] = "Optional. Max size in MB of the batches spooled while the bulk endpoint is down; "
+                                            "the oldest are dropped beyond it. 0 is unlimited. Default value is 1024.";
+static const char log_binary_message[] = "Optional. Write the trajectory log in the compact binary format (<name>-peopletracker.bin) "
+                                         "instead of CSV. Use traj_convert to export it to CSV or NDJSON.";
+static const char log_mode_message[] = "Optional. What -out logs about the tracks: \"frames\" (one trajectory row per person "
+                                       "and frame, default), \"events\" (track start/end, zone enter/exit, line crossings and "
+                                       "contact start/end with a trajectory summary, to <name>-events.csv) or \"both\".";
+static const char simplify_message[] = "Optional. Drop track positions that lie within this many pixels of the line through "
+                                       "the kept ones, from the drawn tracks and the trajectory log. 0 keeps every position "
+                                       "(default); 2 is not visible on the drawn tracks.";
+static const char metrics_port_message[] = "Optional. Serve Prometheus metrics (per-stage latency histograms, fps, active tracks, "
+                                           "reid calls, queue depths) on http://<host>:<port>/metrics. 0 disables it (default).";
+static const char trace_message[] = "Optional. Record per-frame stage spans of all threads for -trace_sec seconds "
+                                    "and write them to this file in the Chrome trace-event format "
+                                    "(open it in chrome://tracing or ui.perfetto.dev).";
+static const char trace_sec_message[] = "Optional. Duration of the -trace recording in seconds. Default value is 10.";
+static const char lines_message[] = "Optional. Count people crossing the lines in configs/line_config.txt (in/out per line). "
+                                    "With -out the counts are written to <name>-lines.csv once per -line_bucket.";
+static const char line_bucket_message[] = "Optional. Length of a line-crossing count bucket in seconds. Default value is 60.";
+static const char flows_message[] = "Optional. Count people per first and last zone they visited (origin/destination "
+                                    "matrix of -zones). With -out the counts are written to <name>-flows.csv once per -flow_bucket.";
+static const char flow_bucket_message[] = "Optional. Length of a zone flow count bucket in seconds. Default value is 60.";
+static const char contacts_message[] = "Optional. Track how long people stay closer than -th (requires -th). "
+                                       "With -out every finished contact is written to <name>-contacts.csv.";
+static const char contact_gap_message[] = "Optional. Longest time in ms two people may be apart within one contact. "
+                                          "Default value is 1000.";
+static const char contact_min_message[] = "Optional. Contacts shorter than this many ms are not logged. Default value is 0.";
+static const char occupancy_message[] = "Optional. Count the people in the frame and in every -zones zone (average, peak, "
+                                        "unique people) per second, minute and hour. With -out the counts are written to "
+                                        "<name>-occupancy.csv.";
+static const char zones_message[] = "Optional. Track visits of the zones in configs/zone_config.txt (enter time and dwell per zone). "
+                                    "With -out the visits are written to <name>-zones.csv.";
 DEFINE_bool(h, false, help_message);
 DEFINE_uint32(first, 0, first_frame_message);
 DEFINE_uint32(read_limit, gflags::uint32(std::numeric_limits<size_t>::max()), read_limit_message);
@@ -67,6 +117,30 @@ DEFINE_string(th, "",configuration_message);
 DEFINE_string(reconfig, "",re_configuration_message);
 DEFINE_string(out_a, "",output_a_log_message);
 DEFINE_bool(stream,false,stream_message);
+DEFINE_uint32(log_sync, 10, log_sync_message);
+DEFINE_uint32(log_queue, 1 << 16, log_queue_message);
+DEFINE_bool(log_binary, false, log_binary_message);
+DEFINE_string(log_mode, "frames", log_mode_message);
+DEFINE_double(simplify, 0, simplify_message);
+DEFINE_string(bulk_url, "", bulk_url_message);
+DEFINE_uint32(bulk_batch, 500, bulk_batch_message);
+DEFINE_uint32(bulk_flush, 5, bulk_flush_message);
+DEFINE_uint32(bulk_spool_mb, 1024, bulk_spool_mb_message);
+DEFINE_uint32(log_rotate_mb, 0, log_rotate_mb_message);
+DEFINE_uint32(log_rotate_min, 0, log_rotate_min_message);
+DEFINE_uint32(log_compress_min, 10, log_compress_min_message);
+DEFINE_uint32(metrics_port, 0, metrics_port_message);
+DEFINE_string(trace, "", trace_message);
+DEFINE_uint32(trace_sec, 10, trace_sec_message);
+DEFINE_bool(lines, false, lines_message);
+DEFINE_uint32(line_bucket, 60, line_bucket_message);
+DEFINE_bool(zones, false, zones_message);
+DEFINE_bool(flows, false, flows_message);
+DEFINE_uint32(flow_bucket, 60, flow_bucket_message);
+DEFINE_bool(contacts, false, contacts_message);
+DEFINE_bool(occupancy, false, occupancy_message);
+DEFINE_uint32(contact_gap, 1000, contact_gap_message);
+DEFINE_uint32(contact_min, 0, contact_min_message);
 //-----//
 /**
  * @brief This function show a help message
@@ -101,4 +175,28 @@ static void showUsage() {
     std::cout << "    -reconfig                         " << re_configuration_message << std::endl;
     std::cout << "    -out_a                            " << output_a_log_message << std::endl;
     std::cout << "    -stream                           " << stream_message << std::endl;
+    std::cout << "    -log_sync                         " << log_sync_message << std::endl;
+    std::cout << "    -log_queue                        " << log_queue_message << std::endl;
+    std::cout << "    -log_binary                       " << log_binary_message << std::endl;
+    std::cout << "    -log_mode \"<mode>\"                " << log_mode_message << std::endl;
+    std::cout << "    -simplify                         " << simplify_message << std::endl;
+    std::cout << "    -log_rotate_mb                    " << log_rotate_mb_message << std::endl;
+    std::cout << "    -log_rotate_min                   " << log_rotate_min_message << std::endl;
+    std::cout << "    -log_compress_min                 " << log_compress_min_message << std::endl;
+    std::cout << "    -bulk_url \"<url>\"                 " << bulk_url_message << std::endl;
+    std::cout << "    -bulk_batch                       " << bulk_batch_message << std::endl;
+    std::cout << "    -bulk_flush                       " << bulk_flush_message << std::endl;
+    std::cout << "    -bulk_spool_mb                    " << bulk_spool_mb_message << std::endl;
+    std::cout << "    -metrics_port                     " << metrics_port_message << std::endl;
+    std::cout << "    -trace \"<path>\"                   " << trace_message << std::endl;
+    std::cout << "    -trace_sec                        " << trace_sec_message << std::endl;
+    std::cout << "    -lines                            " << lines_message << std::endl;
+    std::cout << "    -line_bucket                      " << line_bucket_message << std::endl;
+    std::cout << "    -zones                            " << zones_message << std::endl;
+    std::cout << "    -flows                            " << flows_message << std::endl;
+    std::cout << "    -flow_bucket                      " << flow_bucket_message << std::endl;
+    std::cout << "    -contacts                         " << contacts_message << std::endl;
+    std::cout << "    -occupancy                        " << occupancy_message << std::endl;
+    std::cout << "    -contact_gap                      " << contact_gap_message << std::endl;
+    std::cout << "    -contact_min                      " << contact_min_message << std::endl;
 }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+///
+/// \brief Bounded lock-free queue for one producer and one consumer thread.
+///
+/// Neither side ever blocks: TryPush fails when the queue is full and
+/// TryPop fails when it is empty.
+///
+template <typename T>
+class SpscQueue {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] capacity Max number of elements, rounded up to a power of two.
+    ///
+    explicit SpscQueue(size_t capacity) : head_(0), tail_(0) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    ///
+    /// \brief Adds an element. Must be called from the producer thread only.
+    /// \param[in] value Element to add.
+    /// \return false if the queue is full.
+    ///
+    bool TryPush(const T &value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == buffer_.size()) {
+            return false;
+        }
+        buffer_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    ///
+    /// \brief Removes an element. Must be called from the consumer thread only.
+    /// \param[out] value Removed element.
+    /// \return false if the queue is empty.
+    ///
+    bool TryPop(T *value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *value = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    ///
+    /// \brief Number of queued elements (approximate if called while the
+    /// other thread works with the queue).
+    ///
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    ///
+    /// \brief Max number of elements.
+    ///
+    size_t capacity() const { return buffer_.size(); }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    std::atomic<size_t> head_;  ///< Index of the next element to pop.
+    // Keeps head_ and tail_, written by different threads, a cache line
+    // apart. Padding rather than alignas, which would over-align the owner
+    // of the queue for operator new.
+    char pad_[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail_;  ///< Index of the next element to push.
+};
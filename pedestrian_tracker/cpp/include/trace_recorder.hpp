@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+///
+/// \brief Records timed spans of all threads and writes them as a Chrome
+/// trace-event file (chrome://tracing, Perfetto).
+///
+/// Every thread appends to its own preallocated buffer, so recording takes
+/// no lock. Recording stops when the duration given to Start has passed or
+/// a thread's buffer is full; later spans are ignored.
+///
+class TraceRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ///
+    /// \brief Starts recording.
+    /// \param[in] duration Time after which recording stops.
+    ///
+    static void Start(std::chrono::milliseconds duration);
+
+    ///
+    /// \brief Whether spans are being recorded now.
+    ///
+    static bool Active() {
+        return active_.load(std::memory_order_relaxed) &&
+               Clock::now().time_since_epoch().count() < deadline_.load(std::memory_order_relaxed);
+    }
+
+    ///
+    /// \brief Whether recording was started and its duration has passed.
+    ///
+    static bool Expired() {
+        return active_.load(std::memory_order_relaxed) && !Active();
+    }
+
+    ///
+    /// \brief Records a span of the calling thread.
+    /// \param[in] name Span name; must be a string literal.
+    /// \param[in] begin Start of the span.
+    /// \param[in] end End of the span.
+    ///
+    static void Record(const char *name, Clock::time_point begin, Clock::time_point end);
+
+    ///
+    /// \brief Names the calling thread in the trace.
+    /// \param[in] name Thread name; must be a string literal.
+    ///
+    static void SetThreadName(const char *name);
+
+    ///
+    /// \brief Stops recording and writes the recorded spans. A file that
+    /// can't be written only gets a warning; the trace is diagnostics and
+    /// must not stop the run.
+    /// \param[in] path Output JSON file.
+    /// \return false if the file could not be written.
+    ///
+    static bool Write(const std::string &path);
+
+private:
+    static std::atomic<bool> active_;
+    static std::atomic<Clock::rep> deadline_;
+};
+
+///
+/// \brief Records the span of its own lifetime if tracing is active.
+///
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name)
+        : name_(TraceRecorder::Active() ? name : nullptr),
+        begin_(name_ ? TraceRecorder::Clock::now() : TraceRecorder::Clock::time_point()) {}
+
+    ~TraceSpan() {
+        if (name_) TraceRecorder::Record(name_, begin_, TraceRecorder::Clock::now());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name_;
+    TraceRecorder::Clock::time_point begin_;
+};
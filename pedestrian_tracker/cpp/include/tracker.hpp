@@ -6,6 +6,7 @@
 
 #include "core.hpp"
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
@@ -18,6 +19,8 @@
 #include "utils.hpp"
 #include "descriptor.hpp"
 #include "distance.hpp"
+#include "line_counter.hpp"
+#include "motion_model.hpp"
 
 ///
 /// \brief The TrackerParams struct stores parameters of PedestrianTracker
@@ -50,7 +53,11 @@ struct TrackerParams {
     cv::Vec2f bbox_heights_range;  ///< Bounding box heights range.
 
     int predict;  ///< How many frames are used to predict bounding box in case
-    /// of lost track.
+    /// of lost track (only if 'kalman_predict' is disabled).
+
+    bool kalman_predict;  ///< Predict bounding boxes with a constant-velocity
+                          /// Kalman filter kept per track. If it's disabled
+                          /// the motion is averaged over last 'predict' boxes.
 
     float strong_affinity_thr;  ///< If 'fast' confidence is greater than this
                                 /// threshold then 'strong' Re-ID approach is
@@ -65,12 +72,29 @@ struct TrackerParams {
                                    /// restricted by this parameter. If it is negative or zero, the max number of
                                    /// objects in track is not restricted.
 
+    bool emit_detection_log;  ///< Collect detection log entries of valid tracks
+                              /// while frames are processed (see TakeDetectionLog).
+
+    float simplify_tolerance;  ///< Drop boxes of a track whose centers lie within
+                               /// this many pixels of the polyline through the kept
+                               /// ones, from the track history and the detection
+                               /// log. Zero keeps every box.
+
     ///
     /// Default constructor.
     ///
     TrackerParams();
 };
 
+///
+/// \brief Step of a track between two frames, as passed to the line counter.
+///
+struct TrackStep {
+    cv::Point2f from;    ///< Bottom point of the previous box.
+    cv::Point2f to;      ///< Bottom point of the new box.
+    uint64_t timestamp;  ///< Time of the new box in ms.
+};
+
 ///
 /// \brief The Track struct describes tracks.
 ///
@@ -84,20 +108,19 @@ struct Track {
     /// \param descriptor_strong Strong descriptor (reid embedding).
     ///
     Track(const TrackedObjects &objs, const cv::Mat &last_image,
-          const cv::Mat &descriptor_fast, const cv::Mat &descriptor_strong, 
-          int in_roi, uint64_t timestamp, int time_stay)
+          const cv::Mat &descriptor_fast, const cv::Mat &descriptor_strong)
         : objects(objs),
         predicted_rect(!objs.empty() ? objs.back().rect : cv::Rect()),
         last_image(last_image),
         descriptor_fast(descriptor_fast),
         descriptor_strong(descriptor_strong),
         lost(0),
-        is_in_roi(in_roi),
-        timestamp_roi(timestamp),
-        time_of_stay(time_stay),
-        length(1) {
+        length(1),
+        log_id(-1),
+        logged_frame(-1) {
             PT_CHECK(!objs.empty());
             first_object = objs[0];
+            motion.Init(objs.back().rect, objs.back().frame_idx);
         }
 
 
@@ -151,24 +174,39 @@ struct Track {
     TrackedObjects objects;   ///< Detected objects;
     cv::Rect predicted_rect;  ///< Rectangle that represents predicted position
                               /// and size of bounding box if track has been lost.
-    cv::Mat last_image;       ///< Image of last detected object in track.
+    cv::Mat last_image;       ///< Image of last detected object in track at
+                              /// reid input size. Kept only while the strong
+                              /// descriptor of the track is not computed.
     cv::Mat descriptor_fast;  ///< Fast descriptor.
     cv::Mat descriptor_strong;  ///< Strong descriptor (reid embedding).
     size_t lost;                ///< How many frames ago track has been lost.
+    KalmanBoxFilter motion;     ///< Motion model of the bounding box.
 
     TrackedObject first_object;  ///< First object in track.
-    //-----//
-    int is_in_roi;  ///< flag for whether the track is in ROI (-1 if outside of ROI)
-                    ///                                       (0 if inside of ROI)
-                    ///                                       (1 if tracked object go outside of ROI)                                               
-    uint64_t timestamp_roi; ///< inital time when tracked object is inside ROI
-    int time_of_stay;    ///< time of stay (in seconds) in a ROI (region of interest).
-    //-----//
     size_t length;  ///< Length of a track including number of objects that were
                     /// removed from track in order to avoid memory usage growth.
+    int log_id;     ///< Object ID of the track in detection log (-1 until the
+                    /// track becomes valid).
+    int logged_frame;  ///< Frame index of the last object of the track added to
+                       /// detection log.
+    std::vector<cv::Point2f> dropped;  ///< Centers of the objects dropped by the
+                                       /// simplification since the last kept one.
+    std::vector<TrackStep> line_steps;  ///< Steps kept from the line counter
+                                        /// until the track becomes valid.
     
 };
 
+///
+/// \brief The CropMemoryStats struct describes memory held by track crops.
+///
+struct CropMemoryStats {
+    size_t held_bytes;  ///< Bytes currently held by Track::last_image.
+    size_t full_bytes;  ///< Bytes full-size crops of the last boxes of all
+                        /// tracks would take.
+
+    CropMemoryStats() : held_bytes(0), full_bytes(0) {}
+};
+
 ///
 /// \brief Online pedestrian tracker algorithm implementation.
 ///
@@ -191,6 +229,70 @@ public:
     using Descriptor = std::shared_ptr<IImageDescriptor>;
     using Distance = std::shared_ptr<IDescriptorDistance>;
 
+    ///
+    /// \brief The TrackView struct is a read-only reference to a track.
+    ///
+    struct TrackView {
+        size_t id;           ///< Track ID.
+        const Track &track;  ///< Referenced track.
+
+        ///
+        /// \brief Center of the i-th object of the track.
+        /// \param i Index of object.
+        /// \return Center of the object bounding box.
+        ///
+        cv::Point center(size_t i) const {
+            const cv::Rect &rect = track[i].rect;
+            return cv::Point(static_cast<int>(rect.x + rect.width * 0.5),
+                             static_cast<int>(rect.y + rect.height * 0.5));
+        }
+    };
+
+    ///
+    /// \brief The ActiveTracksView class iterates over valid active tracks
+    /// in place. Tracks are neither copied nor collected into a container.
+    ///
+    class ActiveTracksView {
+    public:
+        class Iterator {
+        public:
+            Iterator(const PedestrianTracker &tracker,
+                     std::set<size_t>::const_iterator it)
+                : tracker_(&tracker), it_(it) { SkipInvalid(); }
+
+            TrackView operator*() const {
+                return TrackView{*it_, tracker_->tracks().at(*it_)};
+            }
+
+            Iterator &operator++() {
+                ++it_;
+                SkipInvalid();
+                return *this;
+            }
+
+            bool operator!=(const Iterator &other) const { return it_ != other.it_; }
+
+        private:
+            void SkipInvalid() {
+                while (it_ != tracker_->active_track_ids().end() &&
+                       (!tracker_->IsTrackValid(*it_) || tracker_->IsTrackForgotten(*it_))) {
+                    ++it_;
+                }
+            }
+
+            const PedestrianTracker *tracker_;
+            std::set<size_t>::const_iterator it_;
+        };
+
+        explicit ActiveTracksView(const PedestrianTracker &tracker) : tracker_(tracker) {}
+
+        Iterator begin() const { return Iterator(tracker_, tracker_.active_track_ids().begin()); }
+        Iterator end() const { return Iterator(tracker_, tracker_.active_track_ids().end()); }
+
+    private:
+        const PedestrianTracker &tracker_;
+    };
+
     ///
     /// \brief Constructor that creates an instance of the pedestrian tracker with
     /// parameters.
@@ -263,6 +365,20 @@ public:
     ///
     void set_distance_strong(const Distance &val);
 
+    ///
+    /// \brief Line counter getter.
+    /// \return Counter of line crossings, null if lines are not counted.
+    ///
+    const std::shared_ptr<LineCounter> &line_counter() const;
+
+    ///
+    /// \brief Line counter setter. Steps of a track are passed to the counter
+    /// once the track is valid and has a detection log ID, so tracks that
+    /// never become valid are not counted. Requires emit_detection_log.
+    /// \param[in] val Counter every step of a tracked object is passed to.
+    ///
+    void set_line_counter(const std::shared_ptr<LineCounter> &val);
+
     ///
     /// \brief Returns a detection log which is used for tracks saving.
     /// \param[in] valid_only If it is true the method returns valid track only.
@@ -271,18 +387,30 @@ public:
     DetectionLog GetDetectionLog(const bool valid_only) const;
 
     ///
-    /// \brief Returns a detection extra log which is used for tracks saving.
-    /// \param[in] log_track a single track 
-    /// \return a detection extra log which is used for tracks saving.
+    /// \brief Returns detection log entries of frames that can no longer
+    /// change and removes them from the tracker. Every entry is returned
+    /// exactly once. Requires 'emit_detection_log' parameter.
+    /// \param[in] flush If it is true entries of all processed frames are
+    /// returned (e.g. at the end of input).
+    /// \return Finished detection log entries ordered by frame index.
     ///
-    DetectionLogExtraEntry GetDetectionLogExtra(const Track &log_track) const;
+    DetectionLog TakeDetectionLog(bool flush = false);
 
     ///
     /// \brief Get active tracks to draw
+    /// \deprecated Use ActiveTracks(). This builds a vector of centers for
+    /// every active track on each call and is kept for external callers
+    /// only; nothing in the tracker calls it per frame.
     /// \return Active tracks.
     ///
     std::unordered_map<size_t, std::vector<cv::Point> > GetActiveTracks() const;
 
+    ///
+    /// \brief Read-only view over valid active tracks (no copies are made).
+    /// \return View over active tracks.
+    ///
+    ActiveTracksView ActiveTracks() const;
+
     ///
     /// \brief Get tracked detections.
     /// \return Tracked detections.
@@ -296,6 +424,12 @@ public:
     ///
     cv::Mat DrawActiveTracks(const cv::Mat &frame);
 
+    ///
+    /// \brief Draws active tracks in place.
+    /// \param[in,out] frame Colored image (CV_8UC3).
+    ///
+    void DrawActiveTracks(cv::Mat *frame);
+
     ///
     /// \brief IsTrackForgotten returns true if track is forgotten.
     /// \param id Track ID.
@@ -329,10 +463,22 @@ public:
     void PrintReidPerformanceCounts(std::string fullDeviceName) const;
 
     ///
-    /// \brief Check weather tracks are in the area of interest
-    /// \param roi the ROI (region of interest)
-    /// \return a list of tracks that left the ROI 
-    std::vector<Track> CheckInRoi(const std::vector<cv::Point2f> &roi);
+    /// \brief Number of images passed to the strong descriptor (reid) so far.
+    /// \return Number of reid descriptor computations.
+    ///
+    size_t reid_calls() const;
+
+    ///
+    /// \brief Time spent in the strong descriptor (reid) so far.
+    /// \return Total reid time.
+    ///
+    std::chrono::steady_clock::duration reid_time() const;
+
+    ///
+    /// \brief Memory taken by the crops kept for reid.
+    /// \return Held bytes compared to keeping a full-size crop per track.
+    ///
+    CropMemoryStats GetCropMemoryStats() const;
 
 private:
     struct Match {
@@ -361,7 +507,6 @@ private:
 
     const ObjectTracks all_tracks(bool valid_only) const;
 
-    const std::vector<Track> all_valid_tracks(bool valid_only) const;
     // Returns shape affinity.
     static float ShapeAffinity(float w, const cv::Rect &trk, const cv::Rect &det);
 
@@ -429,6 +574,9 @@ private:
                        const cv::Mat &descriptor_fast,
                        const cv::Mat &descriptor_strong);
 
+    void UpdateLastImage(const cv::Mat &frame, const cv::Rect &rect,
+                         Track *track) const;
+
     bool EraseTrackIfBBoxIsOutOfFrame(size_t track_id);
 
     bool EraseTrackIfItWasLostTooManyFramesAgo(size_t track_id);
@@ -437,6 +585,14 @@ private:
 
     void UpdateLostTracks(const std::set<size_t> &track_ids);
 
+    void SimplifyTail(Track *track, const cv::Rect &next) const;
+
+    void AddToDetectionLog(size_t track_id, bool with_tail = false);
+
+    void CountLineStep(Track *track, const TrackStep &step);
+
+    void UpdateDetectionLog();
+
     const std::set<size_t> &active_track_ids() const;
 
     TrackedObjects FilterDetections(const TrackedObjects &detections) const;
@@ -460,6 +616,9 @@ private:
     // Distance strong (reid classifier).
     Distance distance_strong_;
 
+    // Counter of line crossings.
+    std::shared_ptr<LineCounter> line_counter_;
+
     // All tracks.
     std::unordered_map<size_t, Track> tracks_;
 
@@ -481,7 +640,25 @@ private:
 
     cv::Size frame_size_;
 
+    // Bytes per pixel of the processed frames, and so of unresized crops.
+    size_t frame_elem_size_;
+
     std::vector<cv::Scalar> colors_;
 
     uint64_t prev_timestamp_;
+
+    // Number of images passed to the strong descriptor.
+    size_t reid_calls_;
+
+    // Time spent in the strong descriptor.
+    std::chrono::steady_clock::duration reid_time_;
+
+    // Detection log objects of valid tracks grouped by frame index.
+    std::map<int, TrackedObjects> pending_log_;
+
+    // Frames before this index can no longer get new detection log objects.
+    int log_horizon_;
+
+    // Number of tracks added to detection log.
+    int log_tracks_counter_;
 };
@@ -8,6 +8,7 @@
 #include "logging.hpp"
 #include "logObject.hpp"
 #include "config_log_paths.hpp"
+#include "log_writer.hpp"
 
 #include <set>
 #include <string>
@@ -82,71 +83,6 @@ struct DetectionLogEntry {
 
 /// Detection log is a vector of detection entries.
 using DetectionLog = std::vector<DetectionLogEntry>;
-///
-/// \brief The DetectionLogExtra Entry struct
-///
-/// An entry describing the time of stay of tracked objects in a ROI
-///
-struct DetectionLogExtraEntry{
-    int object_id;      ///< Tracked objects id
-    uint64_t init_time; ///< The inital time when tracked object is in the roi (0 if N/A)
-    int time_of_stay;   ///< The time of stay of tracked object in ROI 
-    std::string location; ///< The location of the system
-    ///
-    /// \brief DetectionLogExtraEntry default constructor.
-    ///
-    DetectionLogExtraEntry() : init_time(0), time_of_stay(0) {}
-
-    ///
-    /// \brief DetectionLogExtraEntry constructor.
-    ///
-    DetectionLogExtraEntry(std::string locat) : init_time(0), time_of_stay(0), location(locat) {}
-
-    ///
-    /// \brief DetectionLogExtraEntry copy constructor.
-    /// \param other Detection extra entry.
-    ///
-    DetectionLogExtraEntry(const DetectionLogExtraEntry &other)
-        : object_id(other.object_id),
-        init_time(other.init_time),
-        time_of_stay(other.time_of_stay),
-        location(other.location) {}
-
-    ///
-    /// \brief DetectionLogExtraEntry move constructor.
-    /// \param other Detection extra entry.
-    ///
-    DetectionLogExtraEntry(DetectionLogExtraEntry &&other)
-        : object_id(other.object_id),
-        init_time(other.init_time),
-        time_of_stay(other.time_of_stay),
-        location(other.location) {}
-
-    ///
-    /// \brief Assignment operator.
-    /// \param other Detection extra entry.
-    /// \return Detection extra entry.
-    ///
-    DetectionLogExtraEntry &operator=(const DetectionLogExtraEntry &other) = default;
-
-    ///
-    /// \brief Move assignment operator.
-    /// \param other Detection extra entry.
-    /// \return Detection extra entry.
-    ///
-    DetectionLogExtraEntry &operator=(DetectionLogExtraEntry &&other) {
-        if (this != &other) {
-            object_id = other.object_id;
-            init_time = other.init_time;
-            time_of_stay = other.time_of_stay;
-            location = other.location;
-        }
-        return *this;
-    }
-};
-/// Detection log extra is a vector of detection extra entries.
-using DetectionLogExtra = std::unordered_map<int, DetectionLogExtraEntry>;
-
 
 ///
 /// \brief Save DetectionLog to a txt file in the format
@@ -159,16 +95,16 @@ void SaveDetectionLogToTrajFile(const std::string& path,
                                 const DetectionLog& log,
                                 const std::string& location,
                                 const std::string& uuid);
-                      
+
 ///
-/// \brief Save DetectionExtraLog to a txt file in the format
-///        (id,inital_time,time_of_stay)
-///        
-/// \param[in] path -- path to a file to store
-/// \param[in] log  -- detection extra log to store
+/// \brief Queue DetectionLog rows for the trajectory log written
+///        by the log writer thread. Never blocks on I/O.
+/// \param[in] writer -- log writer
+/// \param[in] log  -- detection log to append
 ///
-void SaveDetectionLogToTrajFile(const std::string& path,
-                                const DetectionLogExtra& log);
+void SaveDetectionLogToTrajFile(AsyncLogWriter& writer,
+                                const DetectionLog& log);
+                      
                                 
 ///
 /// \brief Print DetectionLog to stdout in the format
@@ -226,6 +162,12 @@ void MouseCallBack(int event, int x, int y, int flags, void* param);
 /// \param[in] name name of the window
 void SetPoints(MouseParams* mp,unsigned int point_num,std::string name);
 
+///
+/// \brief reading all points of a config file (a text file containing points)
+/// \param[in] path Path to the file
+/// \return points a list of points(x,y coordinates)
+std::vector<cv::Point2f> ReadConfigPoints(const std::string& path);
+
 /// 
 /// \brief reading the camera config file (a text file containing points)
 /// \param[in] path Path to the file
@@ -256,7 +198,7 @@ float ToFloat(const std::string &str);
 /// \param[in] mp a struct containing reference image and mouse input
 void ReConfigWindow(const std::string &window_name, MouseParams* mp);
 ///
-/// \brief reconfig either camera or roi config file 
+/// \brief reconfig the camera, roi or counting line config file 
 /// \param[in] input a string
 /// \param[in] mp a struct containing reference image and point clicked
 /// \return keyword for either camera config or roi config 
@@ -290,6 +232,24 @@ std::string GetLogPath(const std::string &file_name,const std::string &extension
 /// \param[in] path string containing the path to the new directory
 /// \return a bool to signify success or failure
 bool CreateDir(const std::string &path);
+///
+/// \brief Direction a pedestrian walked in, relative to the camera.
+///
+enum class MoveDirection : uint8_t { kLeft, kRight, kForward, kBackward };
+
+///
+/// \brief Direction of a movement, along its larger axis
+/// \param[in] from start position (top left corner of the box)
+/// \param[in] to end position (top left corner of the box)
+/// \return the direction
+MoveDirection GetMoveDirection(const cv::Point &from, const cv::Point &to);
+
+///
+/// \brief Name of a direction as written to the direction log
+/// \param[in] direction the direction
+/// \return LEFT, RIGHT, FORWARD or BACKWARD
+const char *MoveDirectionName(MoveDirection direction);
+
 /// 
 /// \brief Mark which direction the user was heading towards 
 ///        using the log files as an input
@@ -298,9 +258,11 @@ bool CreateDir(const std::string &path);
 std::map<int,std::string> LocateDirection(std::vector<LogInformation> &logList);
 
 ///
-/// \brief write the Direction log to file
+/// \brief write the Direction log to file from a finished trajectory log.
+///        The tracker writes it online (see DirectionEstimator); this rebuilds it.
 /// \param[in] path a string containing the path 
-void WriteDirectionLog(const std::string &path);
+/// \param[in] binary read the binary trajectory log instead of the csv one
+void WriteDirectionLog(const std::string &path, bool binary = false);
 
 ///
 ///
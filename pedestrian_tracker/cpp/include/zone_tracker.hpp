@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "log_writer.hpp"
+#include "tracker.hpp"
+
+class EventStream;
+
+///
+/// \brief Named polygon in image coordinates.
+///
+struct Zone {
+    std::string name;
+    std::vector<cv::Point2f> polygon;
+};
+
+///
+/// \brief Zones rasterized into a label map of the frame.
+///
+/// The polygons are filled once, so finding the zone of a point is a single
+/// pixel lookup however many zones there are. Where zones overlap the later
+/// one in the list wins.
+///
+class ZoneMap {
+public:
+    ///
+    /// \brief Rasterizes the zones.
+    /// \param[in] zones Zones, at most 65535.
+    /// \param[in] frame_size Size of the frames the points come from.
+    ///
+    ZoneMap(const std::vector<Zone> &zones, const cv::Size &frame_size);
+
+    ///
+    /// \brief Finds the zone of a point.
+    /// \param[in] point Point in image coordinates.
+    /// \return Index of the zone, -1 if the point is in none.
+    ///
+    int ZoneAt(const cv::Point2f &point) const {
+        int x = static_cast<int>(point.x);
+        int y = static_cast<int>(point.y);
+        if (x < 0 || y < 0 || x >= labels_.cols || y >= labels_.rows) return -1;
+        return static_cast<int>(labels_.at<uint16_t>(y, x)) - 1;
+    }
+
+    ///
+    /// \brief Draws the zone outlines and names.
+    /// \param[in,out] frame Colored image (CV_8UC3).
+    ///
+    void Draw(cv::Mat *frame) const;
+
+    ///
+    /// \brief Zones getter.
+    /// \return Zones in label order.
+    ///
+    const std::vector<Zone> &zones() const { return zones_; }
+
+    ///
+    /// \brief Number of zones.
+    ///
+    size_t size() const { return zones_.size(); }
+
+private:
+    std::vector<Zone> zones_;
+    cv::Mat labels_;  ///< CV_16U, zone index + 1 per pixel, 0 outside all zones.
+};
+
+///
+/// \brief Visit of a track to a zone.
+///
+struct ZoneEvent {
+    int object_id;        ///< Track ID as written to the trajectory log.
+    int zone;             ///< Index of the zone.
+    uint64_t enter_time;  ///< Time of the first position in the zone in ms.
+    uint64_t exit_time;   ///< Time of the first position out of the zone, or of
+                          /// the last position if the track ended in it, in ms.
+};
+
+///
+/// \brief Number of people per origin and destination zone in one time
+/// bucket.
+///
+struct FlowCount {
+    uint64_t bucket_start;  ///< Start of the bucket in ms.
+    int origin;             ///< First zone the people visited.
+    int destination;        ///< Last zone the people visited.
+    uint32_t count;         ///< Number of people.
+};
+
+///
+/// \brief Origin/destination matrix of zone routes per time bucket.
+///
+/// A route is counted in the bucket it ends in, under its first and last
+/// zone; people who only visited one zone are on the diagonal. Only
+/// non-zero cells are reported, so the output depends on the number of
+/// zones, not on the number of people.
+///
+class FlowMatrix {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] zones Number of zones.
+    /// \param[in] bucket_ms Length of a time bucket in ms.
+    ///
+    FlowMatrix(size_t zones, uint64_t bucket_ms);
+
+    ///
+    /// \brief Starts a new bucket if the time has passed the current one.
+    /// \param[in] timestamp Frame time in ms.
+    ///
+    void Advance(uint64_t timestamp);
+
+    ///
+    /// \brief Counts a finished route.
+    /// \param[in] origin First zone visited by a track.
+    /// \param[in] destination Last zone visited by the track.
+    ///
+    void Add(int origin, int destination);
+
+    ///
+    /// \brief Takes the counts of the finished buckets.
+    /// \param[in] flush Also take the current bucket (e.g. at the end of input).
+    /// \return Non-zero counts ordered by bucket, origin and destination.
+    ///
+    std::vector<FlowCount> TakeCounts(bool flush = false);
+
+private:
+    void CloseBucket();
+
+    size_t zones_;
+    uint64_t bucket_ms_;
+    uint64_t bucket_start_;
+    bool bucket_open_;
+    std::vector<uint32_t> counts_;  ///< zones x zones, row-major by origin.
+    std::vector<FlowCount> finished_;
+};
+
+///
+/// \brief Keeps the zone of every track and reports a visit when the track
+/// leaves the zone or ends.
+///
+/// The zone of a track is the zone of the bottom point of its last box.
+/// Times are frame timestamps, which for video files are the time in the
+/// video, so dwell times match the video, not the processing speed.
+/// Requires the tracker to emit the detection log, since tracks are keyed by
+/// their log IDs.
+///
+/// With a flow matrix the first and last zone of every track are also kept
+/// and added to the matrix when the track ends.
+///
+class ZoneTracker {
+public:
+    ///
+    /// \brief Constructor.
+    /// \param[in] zones Zone map; must outlive the tracker.
+    /// \param[in] flows Matrix the tracks are counted in (may be null); must
+    /// outlive the tracker.
+    ///
+    explicit ZoneTracker(const ZoneMap &zones, FlowMatrix *flows = nullptr);
+
+    ///
+    /// \brief Updates the zones of the tracks with the current frame. Tracks
+    /// that are no longer active leave their zone.
+    /// \param[in] tracker Tracker after processing the frame.
+    ///
+    void Update(const PedestrianTracker &tracker);
+
+    ///
+    /// \brief Ends the visits of all tracks, e.g. at the end of the input.
+    ///
+    void Finish();
+
+    ///
+    /// \brief Takes the visits finished so far.
+    /// \return Finished visits.
+    ///
+    std::vector<ZoneEvent> TakeEvents();
+
+    ///
+    /// \brief Zone map getter.
+    ///
+    const ZoneMap &zones() const { return zones_; }
+
+    ///
+    /// \brief Sets the stream zone entries and exits are also added to.
+    /// \param[in] stream Event stream (may be null); must outlive the tracker.
+    ///
+    void set_event_stream(EventStream *stream) { stream_ = stream; }
+
+private:
+    struct TrackState {
+        int zone;             ///< Current zone, -1 if none.
+        uint64_t enter_time;  ///< Time the track entered the current zone.
+        uint64_t last_time;   ///< Time of the last position.
+        uint64_t seen;        ///< Last update the track was active in.
+        int origin;           ///< First zone visited, -1 if none yet.
+        int destination;      ///< Last zone visited, -1 if none yet.
+    };
+
+    void Leave(int id, TrackState *state, uint64_t time);
+    void End(int id, TrackState *state);
+
+    const ZoneMap &zones_;
+    FlowMatrix *flows_;
+    EventStream *stream_;
+    std::unordered_map<int, TrackState> tracks_;
+    std::vector<ZoneEvent> events_;
+    uint64_t updates_;
+};
+
+///
+/// \brief Reads zones from a config file. Every zone starts with a row
+/// holding its name, followed by one "x y" row per polygon point.
+/// \param[in] path Path to the config file.
+/// \return Zones.
+///
+std::vector<Zone> ReadZoneConfig(const std::string &path);
+
+///
+/// \brief Queues zone visits for the zone log.
+/// \param[in] writer Log writer.
+/// \param[in] events Finished visits.
+///
+void SaveZoneLog(AsyncLogWriter &writer, const std::vector<ZoneEvent> &events);
+
+///
+/// \brief Queues origin/destination counts for the flow log.
+/// \param[in] writer Log writer.
+/// \param[in] counts Counts of finished buckets.
+///
+void SaveFlowLog(AsyncLogWriter &writer, const std::vector<FlowCount> &counts);
+
+///
+/// \brief Queues zone visits for the ROI (time of stay) log.
+/// \param[in] writer Log writer.
+/// \param[in] events Finished visits.
+///
+void SaveRoiLog(AsyncLogWriter &writer, const std::vector<ZoneEvent> &events);
@@ -11,11 +11,22 @@
 #include "pedestrian_tracker.hpp"
 #include "distance_estimate.hpp"
 #include "config_log_paths.hpp"
+#include "log_writer.hpp"
+#include "contact_tracker.hpp"
+#include "direction_estimator.hpp"
+#include "event_stream.hpp"
+#include "occupancy.hpp"
+#include "line_counter.hpp"
+#include "zone_tracker.hpp"
+#include "metrics_server.hpp"
+#include "trace_recorder.hpp"
 #include <monitors/presenter.h>
 #include <utils/images_capture.h>
 #include <chrono>
 #include <nadjieb/mjpeg_streamer.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <utility>
 #include <vector>
@@ -32,12 +43,13 @@ std::unique_ptr<PedestrianTracker>
 CreatePedestrianTracker(const std::string& reid_model,
                         const InferenceEngine::Core & ie,
                         const std::string & deviceName,
-                        bool should_keep_tracking_info) {
+                        bool should_keep_tracking_info,
+                        float simplify_tolerance) {
     TrackerParams params;
+    params.simplify_tolerance = simplify_tolerance;
 
     if (should_keep_tracking_info) {
-        params.drop_forgotten_tracks = false;
-        params.max_num_objects_in_track = -1;
+        params.emit_detection_log = true;
     }
 
     std::unique_ptr<PedestrianTracker> tracker(new PedestrianTracker(params));
@@ -77,6 +89,16 @@ CreatePedestrianTracker(const std::string& reid_model,
     return tracker;
 }
 
+// Adds the time since *start to the stage histogram and the trace, and
+// restarts the clock.
+void ObserveStage(TrackerMetrics &metrics, TrackerMetrics::Stage stage,
+                  std::chrono::steady_clock::time_point *start) {
+    auto now = std::chrono::steady_clock::now();
+    metrics.stages[stage].Observe(now - *start);
+    TraceRecorder::Record(TrackerMetrics::StageName(stage), *start, now);
+    *start = now;
+}
+
 bool ParseAndCheckCommandLine(int argc, char *argv[]) {
     // ---------------------------Parsing and validation of input args--------------------------------------
 
@@ -143,6 +165,21 @@ int main(int argc, char **argv) {
 
         bool should_save_det_log = !detlog_out.empty();
         bool should_save_det_exlog = !detlog_out_a.empty();
+        bool should_send_bulk = !FLAGS_bulk_url.empty();
+        // Trajectory rows go to the log file and/or the bulk endpoint.
+        bool should_queue_det_log = should_save_det_log || should_send_bulk;
+        bool should_count_lines = FLAGS_lines;
+        bool should_count_flows = FLAGS_flows;
+        bool should_track_zones = FLAGS_zones || should_count_flows;
+        if (FLAGS_log_mode != "frames" && FLAGS_log_mode != "events" && FLAGS_log_mode != "both")
+            throw std::runtime_error("Unknown -log_mode: " + FLAGS_log_mode);
+        // Per-frame rows and/or the event stream; both go to -out and -bulk_url.
+        bool should_log_frames = FLAGS_log_mode != "events";
+        bool should_log_events = FLAGS_log_mode != "frames" && should_queue_det_log;
+        bool should_track_contacts = FLAGS_contacts;
+        bool should_count_occupancy = FLAGS_occupancy;
+        if (should_track_contacts && threshold.empty())
+            throw std::runtime_error("-contacts requires -th and a configured camera");
         
         std::vector<std::string> devices{detector_mode, reid_mode};
         InferenceEngine::Core ie =
@@ -153,29 +190,85 @@ int main(int argc, char **argv) {
         DetectorConfig detector_confid(det_model);
         ObjectDetector pedestrian_detector(detector_confid, ie, detector_mode);
 
-        bool should_keep_tracking_info = should_save_det_log || should_print_out;
+        // Zone visits, contacts and unique people are keyed by the track IDs of the detection log.
+        bool should_keep_tracking_info = should_queue_det_log || should_print_out || should_save_det_exlog ||
+                                         should_track_zones || should_track_contacts || should_count_occupancy;
         std::unique_ptr<PedestrianTracker> tracker =
             CreatePedestrianTracker(reid_model, ie, reid_mode,
-                                    should_keep_tracking_info);
+                                    should_keep_tracking_info, static_cast<float>(FLAGS_simplify));
 
         std::unique_ptr<ImagesCapture> cap = openImagesCapture(FLAGS_i, FLAGS_loop, FLAGS_first, FLAGS_read_limit);
         double video_fps = cap->fps();
         
         std::string uuid;
-        if(should_save_det_log){
+        if(should_queue_det_log){
             uuid  = GenUuid();
             std::vector<std::string> temp = SplitString(FLAGS_i, '/');
             if(temp.size() != 0){
                 uuid = uuid + '~' + temp.back();
             }
         }
-        DetectionLogExtra extralog;
+        // Log files are written by a dedicated thread, the loop below only queues rows.
+        std::unique_ptr<AsyncLogWriter> log_writer;
+        if (should_queue_det_log || should_save_det_exlog) {
+            if (!IsPathExist(config_log_paths::PATHTOLOG))
+                CreateDir(config_log_paths::PATHTOLOG);
+            std::chrono::seconds sync_interval(FLAGS_log_sync);
+            LogRotation rotation;
+            rotation.max_bytes = static_cast<size_t>(FLAGS_log_rotate_mb) << 20;
+            rotation.max_age = std::chrono::minutes(FLAGS_log_rotate_min);
+            LogFiles logs;
+            auto open_log = [&](LogRecord::Kind kind, const std::string &path, size_t block_size, bool truncate) {
+                logs[kind].reset(new LogFileWriter(path, sync_interval, block_size, truncate, rotation));
+            };
+            if (should_save_det_log) {
+                if (should_log_frames)
+                    open_log(LogRecord::kTrajectory,
+                             GetLogPath(detlog_out, FLAGS_log_binary ? "-peopletracker.bin" : "-peopletracker.csv"),
+                             1 << 20, true);
+                if (should_log_events)
+                    open_log(LogRecord::kEvent, GetLogPath(detlog_out, "-events.csv"), 1 << 16, true);
+                open_log(LogRecord::kDirection, GetLogPath(detlog_out, "-directions.csv"), 1 << 16, true);
+                if (should_count_lines)
+                    open_log(LogRecord::kLineCount, GetLogPath(detlog_out, "-lines.csv"), 1 << 16, true);
+                if (FLAGS_zones)
+                    open_log(LogRecord::kZone, GetLogPath(detlog_out, "-zones.csv"), 1 << 16, true);
+                if (should_count_flows)
+                    open_log(LogRecord::kFlow, GetLogPath(detlog_out, "-flows.csv"), 1 << 16, true);
+                if (should_track_contacts)
+                    open_log(LogRecord::kContact, GetLogPath(detlog_out, "-contacts.csv"), 1 << 16, true);
+                if (should_count_occupancy)
+                    open_log(LogRecord::kOccupancy, GetLogPath(detlog_out, "-occupancy.csv"), 1 << 16, true);
+            }
+            if (should_save_det_exlog)
+                open_log(LogRecord::kRoi, GetLogPath(detlog_out_a, "-roi.csv"), 1 << 16, false);
+            std::unique_ptr<BulkSink> sink;
+            if (should_send_bulk) {
+                BulkSinkParams sink_params;
+                sink_params.url = FLAGS_bulk_url;
+                sink_params.batch_size = std::max<size_t>(FLAGS_bulk_batch, 1);
+                sink_params.flush_interval = std::chrono::seconds(FLAGS_bulk_flush);
+                sink_params.spool_max_bytes = static_cast<size_t>(FLAGS_bulk_spool_mb) << 20;
+                sink_params.spool_dir = config_log_paths::PATHTOSPOOL;
+                sink.reset(new BulkSink(sink_params));
+            }
+            log_writer.reset(new AsyncLogWriter(std::move(logs), detlocation, uuid, FLAGS_log_queue,
+                                                FLAGS_log_binary, std::move(sink),
+                                                std::chrono::minutes(FLAGS_log_compress_min)));
+        }
         std::vector<cv::Point> poly_line;
         if (0.0 == video_fps) {
             // the default frame rate for DukeMTMC dataset
             video_fps = 60.0;
         }
 
+        // Frames of a video get their time in the video, counted from the start
+        // of the run, so dwell times and rates don't depend on the processing
+        // speed; camera frames and images are stamped when they are read.
+        const bool video_time = cap->getType() == "VIDEO";
+        const uint64_t start_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
         cv::Mat frame = cap->read();
         if (!frame.data) throw std::runtime_error("Can't read an image from the input");
         cv::Size firstFrameSize = frame.size();
@@ -206,9 +299,62 @@ int main(int argc, char **argv) {
             DistanceEstimate temp(frame,points,ToFloat(threshold));
             estimator = temp;
         }
+        // Direction rows are written when a track ends, with the ground
+        // speed if the camera is configured.
+        std::unique_ptr<DirectionEstimator> directions;
+        if (should_queue_det_log) {
+            directions.reset(new DirectionEstimator(threshold.empty() ? nullptr : &estimator));
+        }
+        // Zone, line and contact events are added to the stream by their trackers.
+        std::unique_ptr<EventStream> events;
+        if (should_log_events) {
+            events.reset(new EventStream());
+        }
+        // Only finished contacts are logged, not every close pair of every frame.
+        std::unique_ptr<ContactTracker> contacts;
+        if (should_track_contacts) {
+            contacts.reset(new ContactTracker(estimator, FLAGS_contact_gap, FLAGS_contact_min));
+            contacts->set_event_stream(events.get());
+        }
+        // The ROI and the zones are rasterized once, so the zone of a track is
+        // a pixel lookup per frame.
         std::vector<cv::Point2f> roi_points;
+        std::unique_ptr<ZoneMap> roi_map, zone_map;
+        std::unique_ptr<ZoneTracker> roi_tracker, zone_tracker;
+        std::unique_ptr<FlowMatrix> flows;
         if(should_save_det_exlog){
             roi_points = ReadConfig(config_log_paths::PATHTOROICONFIG,4);
+            roi_map.reset(new ZoneMap({Zone{"roi", roi_points}}, frame.size()));
+            roi_tracker.reset(new ZoneTracker(*roi_map));
+        }
+        if (should_track_zones) {
+            zone_map.reset(new ZoneMap(ReadZoneConfig(config_log_paths::PATHTOZONECONFIG), frame.size()));
+            // Only the origin/destination counts are logged, not the routes.
+            if (should_count_flows)
+                flows.reset(new FlowMatrix(zone_map->size(), static_cast<uint64_t>(FLAGS_flow_bucket) * 1000));
+            zone_tracker.reset(new ZoneTracker(*zone_map, flows.get()));
+            zone_tracker->set_event_stream(events.get());
+            if (log_writer) {
+                std::vector<std::string> zone_names;
+                for (const auto &zone : zone_map->zones()) {
+                    zone_names.push_back(zone.name);
+                }
+                log_writer->SetZoneNames(zone_names);
+            }
+        }
+        // Occupancy is rolled up from seconds to minutes and hours in memory.
+        std::unique_ptr<OccupancyCounter> occupancy;
+        if (should_count_occupancy) {
+            occupancy.reset(new OccupancyCounter(zone_map.get()));
+        }
+        // Crossings are counted by the tracker as tracks are extended, only
+        // the counts per bucket are logged.
+        std::shared_ptr<LineCounter> line_counter;
+        if (should_count_lines) {
+            line_counter = std::make_shared<LineCounter>(ReadLineConfig(config_log_paths::PATHTOLINECONFIG),
+                                                         static_cast<uint64_t>(FLAGS_line_bucket) * 1000);
+            line_counter->set_event_stream(events.get());
+            tracker->set_line_counter(line_counter);
         }
         std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, 90};
         nadjieb::MJPEGStreamer streamer;
@@ -216,22 +362,53 @@ int main(int argc, char **argv) {
             streamer.start(8080);
             GetIpAddress();
         }
+        // Stage latencies and gauges, served on a separate port because the
+        // MJPEG streamer only serves frames.
+        TrackerMetrics metrics;
+        std::unique_ptr<MetricsServer> metrics_server;
+        if (FLAGS_metrics_port > 0) {
+            metrics_server.reset(new MetricsServer(metrics, FLAGS_metrics_port));
+        }
+        std::string trace_path = FLAGS_trace;
+        if (!trace_path.empty()) {
+            TraceRecorder::SetThreadName("main");
+            TraceRecorder::Start(std::chrono::seconds(FLAGS_trace_sec));
+        }
+        auto rate_start = std::chrono::steady_clock::now();
+        uint64_t rate_frames = 0;
+        size_t rate_reid_calls = 0;
         for (unsigned frameIdx = 0; ; ++frameIdx) {
+            auto frame_start = std::chrono::steady_clock::now();
+            auto stage_start = frame_start;
 
-            
             pedestrian_detector.submitFrame(frame, frameIdx);
             pedestrian_detector.waitAndFetchResults();
 
             TrackedObjects detections = pedestrian_detector.getResults();
+            ObserveStage(metrics, TrackerMetrics::kDetect, &stage_start);
             
             // timestamp in milliseconds
-            //uint64_t cur_timestamp = static_cast<uint64_t >(1000.0 / video_fps * frameIdx);
-            uint64_t cur_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            uint64_t cur_timestamp = video_time
+                ? start_timestamp + static_cast<uint64_t>(std::llround(1000.0 / video_fps * frameIdx))
+                : std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            auto reid_time = tracker->reid_time();
             tracker->Process(frame, detections, cur_timestamp);
-
+            // Reid runs inside Process, so it is taken out of the tracking time.
+            auto process_end = std::chrono::steady_clock::now();
+            reid_time = tracker->reid_time() - reid_time;
+            metrics.stages[TrackerMetrics::kReid].Observe(reid_time);
+            metrics.stages[TrackerMetrics::kTrack].Observe(process_end - stage_start - reid_time);
+            TraceRecorder::Record("track", stage_start, process_end);
+            stage_start = process_end;
+
+            if (frameIdx % 100 == 0) {
+                CropMemoryStats crop_stats = tracker->GetCropMemoryStats();
+                presenter.setMemoryNote("crops " + std::to_string(crop_stats.held_bytes / 1024) +
+                                        "/" + std::to_string(crop_stats.full_bytes / 1024) + " KiB");
+            }
             presenter.drawGraphs(frame);
             // Drawing colored "worms" (tracks).
-            frame = tracker->DrawActiveTracks(frame);
+            tracker->DrawActiveTracks(&frame);
 
             // Drawing all detected objects on a frame by BLUE COLOR
             for (const auto &detection : detections) {
@@ -240,30 +417,32 @@ int main(int argc, char **argv) {
 
             // Drawing tracked detections only by RED color and print ID and detection
             // confidence level.
-            for (auto &detection : tracker->TrackedDetections()) {
-                cv::rectangle(frame, detection.rect, cv::Scalar(0, 0, 255), 3);
-                std::string text = std::to_string(detection.object_id) +
-                    " conf: " + std::to_string(detection.confidence);
-            
+            uint64_t active_tracks = 0;
+            for (const auto &view : tracker->ActiveTracks()) {
+                if (!view.track.lost) {
+                    cv::rectangle(frame, view.track.back().rect, cv::Scalar(0, 0, 255), 3);
+                    ++active_tracks;
+                }
             }
-            //getting the logs for pedestrains in region of interest
-            if(should_save_det_exlog && !detlocation.empty()){
-                //draw the region of interest
+            //draw the region of interest
+            if(roi_map){
                 DrawRoi(roi_points,cv::Scalar(70,70,70),&frame,2); 
-                for (auto &track : tracker->CheckInRoi(roi_points)){
-                    DetectionLogExtraEntry entry;
-                    entry = tracker->GetDetectionLogExtra(track);
-                    entry.location = detlocation;
-                    extralog.emplace(entry.object_id,entry);
-                }
+            }
+            if (zone_map) {
+                zone_map->Draw(&frame);
+            }
+            if (line_counter) {
+                line_counter->Draw(&frame);
             }
             framesProcessed++;
+            if (should_show && !threshold.empty()) {
+                estimator.DrawDistance(detections);
+            }
+            ObserveStage(metrics, TrackerMetrics::kDraw, &stage_start);
 
             //Print the relivant frame numbers for the location
+            auto encode_time = std::chrono::steady_clock::duration::zero();
             if (should_show) {
-                if(!threshold.empty()){
-                    estimator.DrawDistance(detections);
-                }
                 //stream the frame to localhost:<port number>/bgr
                 if(should_stream){
                     std::vector<uchar> buff_bgr;
@@ -272,30 +451,108 @@ int main(int argc, char **argv) {
                 }else{
                     cv::imshow("dbg", frame);
                 }              
+                // The key delay is not part of the encode stage.
+                auto show_end = std::chrono::steady_clock::now();
+                encode_time = show_end - stage_start;
+                TraceRecorder::Record("encode", stage_start, show_end);
                 char k = cv::waitKey(delay);
                 if (k == 27)
                     break;
                 presenter.handleKey(k);
+                stage_start = std::chrono::steady_clock::now();
             }
             if (videoWriter.isOpened() && (FLAGS_limit == 0 || framesProcessed <= FLAGS_limit)) {
                 videoWriter.write(frame);
             }
-            //saving logs every 100 frames
-            if (should_save_det_log && (frameIdx % 100 == 0)) {
-                DetectionLog log = tracker->GetDetectionLog(true);
-                SaveDetectionLogToTrajFile(detlog_out, log, detlocation,uuid);
+            auto encode_end = std::chrono::steady_clock::now();
+            metrics.stages[TrackerMetrics::kEncode].Observe(encode_time + (encode_end - stage_start));
+            if (videoWriter.isOpened())
+                TraceRecorder::Record("encode", stage_start, encode_end);
+            stage_start = encode_end;
+            //saving logs of finished frames every 100 frames
+            if (should_keep_tracking_info && (frameIdx % 100 == 0)) {
+                DetectionLog log = tracker->TakeDetectionLog();
+                if (should_queue_det_log && should_log_frames)
+                    SaveDetectionLogToTrajFile(*log_writer, log);
+                if (should_print_out)
+                    PrintDetectionLog(log, detlocation, uuid);
             }
-            if (should_save_det_exlog && (frameIdx % 100 == 0)) {
-                SaveDetectionLogToTrajFile(detlog_out_a, extralog);
-                extralog = DetectionLogExtra();
+            // Tracks are started before the zone and contact events of this frame.
+            if (events) {
+                events->Update(*tracker);
             }
+            if (directions) {
+                directions->Update(*tracker);
+                SaveDirectionLog(*log_writer, directions->TakeFinished());
+            }
+            //getting the logs for pedestrains in region of interest
+            if (roi_tracker) {
+                roi_tracker->Update(*tracker);
+                SaveRoiLog(*log_writer, roi_tracker->TakeEvents());
+            }
+            if (zone_tracker) {
+                if (flows) flows->Advance(cur_timestamp);
+                zone_tracker->Update(*tracker);
+                std::vector<ZoneEvent> events = zone_tracker->TakeEvents();
+                if (should_queue_det_log && FLAGS_zones)
+                    SaveZoneLog(*log_writer, events);
+            }
+            if (flows) {
+                std::vector<FlowCount> counts = flows->TakeCounts();
+                if (should_queue_det_log)
+                    SaveFlowLog(*log_writer, counts);
+            }
+            if (contacts) {
+                contacts->Update(*tracker, cur_timestamp);
+                std::vector<ContactEvent> events = contacts->TakeEvents();
+                if (should_queue_det_log)
+                    SaveContactLog(*log_writer, events);
+            }
+            if (line_counter) {
+                std::vector<LineCount> counts = line_counter->TakeCounts();
+                if (should_queue_det_log)
+                    SaveLineCounts(*log_writer, counts);
+            }
+            if (occupancy) {
+                occupancy->Update(*tracker, cur_timestamp);
+                std::vector<OccupancyBucket> buckets = occupancy->TakeBuckets();
+                if (should_queue_det_log)
+                    SaveOccupancyLog(*log_writer, buckets);
+            }
+            if (events) {
+                SaveEventLog(*log_writer, events->TakeEvents());
+            }
+            ObserveStage(metrics, TrackerMetrics::kLog, &stage_start);
+
+            metrics.frames.store(framesProcessed);
+            metrics.active_tracks.store(active_tracks);
+            metrics.reid_calls.store(tracker->reid_calls());
+            if (log_writer) {
+                metrics.log_queue_depth.store(log_writer->queue_depth());
+                metrics.log_queue_high_water.store(log_writer->high_water_mark());
+                metrics.log_dropped.store(log_writer->dropped());
+                if (log_writer->sink())
+                    metrics.bulk_pending.store(log_writer->sink()->pending());
+            }
+            auto rate_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - rate_start).count();
+            if (rate_elapsed >= 1.0) {
+                metrics.fps.store((framesProcessed - rate_frames) / rate_elapsed);
+                metrics.reid_per_sec.store((tracker->reid_calls() - rate_reid_calls) / rate_elapsed);
+                rate_start = std::chrono::steady_clock::now();
+                rate_frames = framesProcessed;
+                rate_reid_calls = tracker->reid_calls();
+            }
+
+            stage_start = std::chrono::steady_clock::now();
             frame = cap->read();
+            ObserveStage(metrics, TrackerMetrics::kCapture, &stage_start);
+            TraceRecorder::Record("frame", frame_start, stage_start);
+            if (!trace_path.empty() && TraceRecorder::Expired()) {
+                if (TraceRecorder::Write(trace_path)) std::cout << "Trace written to " << trace_path << std::endl;
+                trace_path.clear();
+            }
             cv::waitKey(20);
             if (!frame.data){
-                //Write out user direction log
-                if(should_save_det_log){
-                    WriteDirectionLog(detlog_out);
-                }
                 if(should_stream){
                     streamer.stop();
                 }
@@ -304,12 +561,60 @@ int main(int argc, char **argv) {
             if (frame.size() != firstFrameSize)
                 throw std::runtime_error("Can't track objects on images of different size");
         }
+        if (!trace_path.empty()) {
+            if (TraceRecorder::Write(trace_path)) std::cout << "Trace written to " << trace_path << std::endl;
+        }
+        if (line_counter) {
+            std::vector<LineCount> counts = line_counter->TakeCounts(true);
+            if (should_queue_det_log)
+                SaveLineCounts(*log_writer, counts);
+            for (size_t i = 0; i < line_counter->lines().size(); i++) {
+                std::cout << "Line " << i << ": " << line_counter->total(i).first << " in, "
+                          << line_counter->total(i).second << " out" << '\n';
+            }
+        }
         if (should_keep_tracking_info) {
-            DetectionLog log = tracker->GetDetectionLog(true);
-            if (should_save_det_log)
-                SaveDetectionLogToTrajFile(detlog_out, log, detlocation,uuid);
-            if(should_save_det_exlog)
-                SaveDetectionLogToTrajFile(detlog_out_a,extralog);
+            DetectionLog log = tracker->TakeDetectionLog(true);
+            if (should_queue_det_log && should_log_frames)
+                SaveDetectionLogToTrajFile(*log_writer, log);
+            //Tracks still in the ROI or a zone at the end leave it
+            if (roi_tracker) {
+                roi_tracker->Finish();
+                SaveRoiLog(*log_writer, roi_tracker->TakeEvents());
+            }
+            if (zone_tracker) {
+                zone_tracker->Finish();
+                std::vector<ZoneEvent> events = zone_tracker->TakeEvents();
+                if (should_queue_det_log && FLAGS_zones)
+                    SaveZoneLog(*log_writer, events);
+            }
+            if (flows) {
+                std::vector<FlowCount> counts = flows->TakeCounts(true);
+                if (should_queue_det_log)
+                    SaveFlowLog(*log_writer, counts);
+            }
+            if (contacts) {
+                contacts->Finish();
+                std::vector<ContactEvent> events = contacts->TakeEvents();
+                if (should_queue_det_log)
+                    SaveContactLog(*log_writer, events);
+            }
+            if (occupancy) {
+                std::vector<OccupancyBucket> buckets = occupancy->TakeBuckets(true);
+                if (should_queue_det_log)
+                    SaveOccupancyLog(*log_writer, buckets);
+            }
+            if (events) {
+                events->Finish();
+                SaveEventLog(*log_writer, events->TakeEvents());
+            }
+            //Tracks still active at the end get their direction rows too
+            if (directions) {
+                directions->Finish();
+                SaveDirectionLog(*log_writer, directions->TakeFinished());
+            }
+            if (log_writer)
+                log_writer->Close();
             if (should_print_out)
                 PrintDetectionLog(log, detlocation,uuid);
         }
@@ -319,6 +624,25 @@ int main(int argc, char **argv) {
         }
         
         std::cout << presenter.reportMeans() << '\n';
+        std::cout << "Reader:\n";
+        cap->getMetrics().printTotal();
+        std::cout << "Reid calls: " << tracker->reid_calls() << '\n';
+        if (log_writer) {
+            log_writer->Close();
+            std::cout << "Log queue: high-water mark " << log_writer->high_water_mark()
+                      << " of " << log_writer->capacity() << " records, "
+                      << log_writer->dropped() << " dropped" << '\n';
+            if (should_save_det_log && should_log_frames && framesProcessed > 0) {
+                double video_hours = framesProcessed / video_fps / 3600.0;
+                std::cout << "Trajectory log I/O per hour of video: "
+                          << static_cast<uint64_t>(log_writer->trajectory_bytes() / video_hours) << " bytes" << '\n';
+            }
+            if (log_writer->sink()) {
+                std::cout << "Bulk sink: " << log_writer->sink()->sent() << " documents sent, "
+                          << log_writer->sink()->spooled() << " spooled, " << log_writer->sink()->rejected()
+                          << " rejected" << '\n';
+            }
+        }
     }
     catch (const std::exception& error) {
         std::cerr << "[ ERROR ] " << error.what() << std::endl;
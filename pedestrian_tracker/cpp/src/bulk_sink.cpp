@@ -0,0 +1,465 @@
+#include "bulk_sink.hpp"
+#include "trace_recorder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <dirent.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+const std::chrono::milliseconds kMinBackoff(1000);
+const std::chrono::milliseconds kMaxBackoff(60000);
+const int kSocketTimeoutSec = 5;
+// Refusals after which a spooled batch is set aside as "*.failed".
+const int kMaxSpoolRefusals = 5;
+
+// Closes the socket when going out of scope.
+struct SocketGuard {
+    int fd;
+    ~SocketGuard() { if (fd != -1) close(fd); }
+};
+
+bool SendAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Decodes a "Transfer-Encoding: chunked" body; stops at the last chunk or
+// at malformed input.
+std::string DecodeChunked(const std::string &body) {
+    std::string decoded;
+    size_t pos = 0;
+    for (;;) {
+        size_t line_end = body.find("\r\n", pos);
+        if (line_end == std::string::npos) break;
+        size_t size = std::strtoul(body.c_str() + pos, nullptr, 16);
+        pos = line_end + 2;
+        if (size == 0 || size > body.size() - pos) break;
+        decoded.append(body, pos, size);
+        pos += size + 2;
+    }
+    return decoded;
+}
+
+// Checks the top of an Elasticsearch bulk response for "errors": true.
+bool HasBulkErrors(const std::string &json) {
+    size_t pos = json.find("\"errors\"");
+    if (pos == std::string::npos) return false;
+    pos = json.find_first_not_of(" \t\r\n:", pos + 8);
+    return pos != std::string::npos && json.compare(pos, 4, "true") == 0;
+}
+
+// Statuses of the items of an Elasticsearch bulk response, in the order of
+// the request. Only the "status" of each item's action object is read;
+// strings are skipped, so error reasons can't be mistaken for keys.
+std::vector<int> BulkItemStatuses(const std::string &json) {
+    std::vector<int> statuses;
+    std::string last_string;
+    int depth = 0;
+    int items_depth = -1;  // Depth inside the "items" array.
+    for (size_t i = 0; i < json.size(); i++) {
+        char c = json[i];
+        if (c == '"') {
+            size_t end = i + 1;
+            while (end < json.size() && json[end] != '"') end += json[end] == '\\' ? 2 : 1;
+            last_string = json.substr(i + 1, end - i - 1);
+            i = end;
+        } else if (c == '{' || c == '[') {
+            depth++;
+            if (c == '[' && depth == 2 && last_string == "items") {
+                items_depth = depth;
+            } else if (c == '{' && items_depth != -1 && depth == items_depth + 1) {
+                statuses.push_back(0);
+            }
+        } else if (c == '}' || c == ']') {
+            if (depth == items_depth) items_depth = -1;
+            depth--;
+        } else if (c == ':' && items_depth != -1 && depth == items_depth + 2 && last_string == "status") {
+            statuses.back() = std::atoi(json.c_str() + i + 1);
+        }
+    }
+    return statuses;
+}
+
+std::vector<std::string> SpoolFiles(const std::string &dir) {
+    std::vector<std::string> files;
+    DIR *d = opendir(dir.c_str());
+    if (!d) return files;
+    while (struct dirent *entry = readdir(d)) {
+        // Other files (e.g. copied there by hand) are left alone.
+        std::string name = entry->d_name;
+        size_t digits = name.find_first_not_of("0123456789");
+        if (digits > 0 && digits != std::string::npos && name.compare(digits, std::string::npos, ".ndjson") == 0) {
+            files.push_back(name);
+        }
+    }
+    closedir(d);
+    // Names are zero-padded sequence numbers, so this is the spooling order.
+    std::sort(files.begin(), files.end());
+    return files;
+}
+}  // anonymous namespace
+
+BulkSinkParams::BulkSinkParams()
+    : people_index("people_tracking"),
+    roi_index("region_of_interest"),
+    directions_index("directions"),
+    lines_index("line_crossings"),
+    zones_index("zones"),
+    flows_index("zone_flows"),
+    contacts_index("contacts"),
+    events_index("track_events"),
+    occupancy_index("occupancy"),
+    batch_size(500),
+    flush_interval(5000),
+    spool_dir("logs/spool/"),
+    spool_max_bytes(size_t(1) << 30) {}
+
+BulkSink::BulkSink(const BulkSinkParams &params)
+    : params_(params),
+    port_("80"),
+    es_bulk_(false),
+    body_docs_(0),
+    stop_(false),
+    sent_(0),
+    spooled_(0),
+    rejected_(0),
+    spool_seq_(0),
+    refused_(false),
+    retry_at_(std::chrono::steady_clock::now()),
+    backoff_(kMinBackoff) {
+    const std::string scheme = "http://";
+    if (params_.url.compare(0, scheme.size(), scheme) != 0) {
+        throw std::runtime_error("Bulk endpoint must be an http:// URL: " + params_.url);
+    }
+    std::string rest = params_.url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string host_port = rest.substr(0, slash);
+    path_ = slash == std::string::npos ? "/" : rest.substr(slash);
+    size_t colon = host_port.rfind(':');
+    host_ = host_port.substr(0, colon);
+    if (colon != std::string::npos) port_ = host_port.substr(colon + 1);
+    if (host_.empty()) {
+        throw std::runtime_error("No host in bulk endpoint URL: " + params_.url);
+    }
+    std::string path_only = path_.substr(0, path_.find('?'));
+    es_bulk_ = path_only.size() >= 5 && path_only.compare(path_only.size() - 5, 5, "_bulk") == 0;
+
+    if (!params_.spool_dir.empty() && params_.spool_dir.back() != '/') params_.spool_dir += '/';
+    mkdir(params_.spool_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    std::vector<std::string> spooled = SpoolFiles(params_.spool_dir);
+    if (!spooled.empty()) {
+        spool_seq_ = std::strtoull(spooled.back().c_str(), nullptr, 10) + 1;
+    }
+
+    thread_ = std::thread(&BulkSink::Run, this);
+}
+
+BulkSink::~BulkSink() {
+    Close();
+}
+
+void BulkSink::Close() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void BulkSink::Add(Kind kind, const std::string &docs, size_t count) {
+    if (count == 0) return;
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Replaces the opening brace of every document.
+        const std::string prefix = es_bulk_ ? "{\"index\":{\"_index\":\"" + Index(kind) + "\"}}\n{"
+                                            : "{\"type\":\"" + std::string(Type(kind)) + "\",";
+        size_t begin = 0;
+        while (begin < docs.size()) {
+            size_t end = docs.find('\n', begin);
+            end = end == std::string::npos ? docs.size() : end + 1;
+            body_ += prefix;
+            body_.append(docs, begin + 1, end - begin - 1);
+            begin = end;
+        }
+        body_docs_ += count;
+        full = body_docs_ >= params_.batch_size;
+    }
+    if (full) cond_.notify_one();
+}
+
+const std::string &BulkSink::Index(Kind kind) const {
+    switch (kind) {
+    case kPeople: return params_.people_index;
+    case kRoi: return params_.roi_index;
+    case kDirections: return params_.directions_index;
+    case kLines: return params_.lines_index;
+    case kZones: return params_.zones_index;
+    case kFlows: return params_.flows_index;
+    case kContacts: return params_.contacts_index;
+    case kEvents: return params_.events_index;
+    default: return params_.occupancy_index;
+    }
+}
+
+const char *BulkSink::Type(Kind kind) {
+    // The Filebeat tags of the logs in logstash_AI.conf.
+    switch (kind) {
+    case kPeople: return "peopletracking";
+    case kRoi: return "roi";
+    case kDirections: return "directions";
+    case kLines: return "lines";
+    case kZones: return "zones";
+    case kFlows: return "flows";
+    case kContacts: return "contacts";
+    case kEvents: return "events";
+    default: return "occupancy";
+    }
+}
+
+uint64_t BulkSink::sent() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sent_;
+}
+
+uint64_t BulkSink::spooled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return spooled_;
+}
+
+uint64_t BulkSink::rejected() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rejected_;
+}
+
+size_t BulkSink::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return body_docs_;
+}
+
+void BulkSink::Run() {
+    TraceRecorder::SetThreadName("bulk sender");
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait_for(lock, params_.flush_interval,
+                       [this] { return stop_ || body_docs_ >= params_.batch_size; });
+        bool stop = stop_;
+        std::string body;
+        size_t docs = body_docs_;
+        body.swap(body_);
+        body_docs_ = 0;
+        lock.unlock();
+
+        // Older batches go first, so documents arrive in order.
+        bool online = SendSpooled();
+        if (docs > 0) {
+            std::string retry;
+            size_t retry_docs = 0;
+            size_t rejected = 0;
+            if (online && Deliver(body, &retry, &retry_docs, &rejected)) {
+                if (!retry.empty()) Spool(retry);
+                lock.lock();
+                sent_ += docs - retry_docs - rejected;
+                spooled_ += retry_docs;
+                rejected_ += rejected;
+                lock.unlock();
+            } else {
+                Spool(body);
+                lock.lock();
+                spooled_ += docs;
+                lock.unlock();
+            }
+        }
+
+        lock.lock();
+        if (stop) break;
+    }
+}
+
+bool BulkSink::SendSpooled() {
+    if (std::chrono::steady_clock::now() < retry_at_) return false;
+    for (const std::string &name : SpoolFiles(params_.spool_dir)) {
+        std::string path = params_.spool_dir + name;
+        std::ifstream file(path, std::ios::binary);
+        std::string body((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::string retry;
+        size_t retry_docs = 0;
+        size_t rejected = 0;
+        if (!Deliver(body, &retry, &retry_docs, &rejected)) {
+            if (!refused_ || ++spool_refusals_[name] < kMaxSpoolRefusals) return false;
+            // A batch the endpoint can never take must not hold up the others.
+            std::string failed = path.substr(0, path.size() - 7) + ".failed";
+            std::cerr << "[ WARNING ] Bulk endpoint refused " << path << " " << kMaxSpoolRefusals
+                      << " times, moved it to " << failed << std::endl;
+            rename(path.c_str(), failed.c_str());
+            spool_refusals_.erase(name);
+            continue;
+        }
+        spool_refusals_.erase(name);
+        // Documents rejected again go to the end of the spool.
+        if (!retry.empty()) Spool(retry);
+        unlink(path.c_str());
+        std::lock_guard<std::mutex> lock(mutex_);
+        rejected_ += rejected;
+    }
+    return true;
+}
+
+void BulkSink::Spool(const std::string &body) {
+    char name[32];
+    snprintf(name, sizeof(name), "%012llu.ndjson", static_cast<unsigned long long>(spool_seq_++));
+    std::ofstream file(params_.spool_dir + name, std::ios::binary);
+    file << body;
+    if (!file) {
+        std::cerr << "[ WARNING ] Can't spool bulk documents to " << params_.spool_dir << name << std::endl;
+    }
+    file.close();
+    TrimSpool();
+}
+
+void BulkSink::TrimSpool() {
+    if (params_.spool_max_bytes == 0) return;
+    std::vector<std::string> files = SpoolFiles(params_.spool_dir);
+    std::vector<size_t> sizes;
+    size_t total = 0;
+    for (const std::string &name : files) {
+        struct stat info;
+        sizes.push_back(stat((params_.spool_dir + name).c_str(), &info) == 0 ? static_cast<size_t>(info.st_size) : 0);
+        total += sizes.back();
+    }
+    // The newest batch is kept even if it alone is over the limit.
+    size_t dropped = 0;
+    for (; dropped + 1 < files.size() && total > params_.spool_max_bytes; dropped++) {
+        unlink((params_.spool_dir + files[dropped]).c_str());
+        total -= sizes[dropped];
+    }
+    if (dropped > 0) {
+        std::cerr << "[ WARNING ] Bulk spool is full, dropped the " << dropped << " oldest batches" << std::endl;
+    }
+}
+
+bool BulkSink::Deliver(const std::string &body, std::string *retry, size_t *retry_docs, size_t *rejected) {
+    std::string response;
+    int status = 0;
+    bool ok = Post(body, &response, &status);
+    // Unreachable, overloaded or failing endpoints may take the batch later.
+    refused_ = status != 0 && status != 408 && status != 429 && status < 500;
+    if (!ok) return false;
+    if (!es_bulk_ || !HasBulkErrors(response)) return true;
+
+    // Every item answers one action line and its document line.
+    std::vector<int> statuses = BulkItemStatuses(response);
+    size_t lines = static_cast<size_t>(std::count(body.begin(), body.end(), '\n'));
+    if (statuses.size() * 2 != lines) {
+        std::cerr << "[ WARNING ] Unexpected Elasticsearch bulk response, the batch is resent" << std::endl;
+        retry_at_ = std::chrono::steady_clock::now() + backoff_;
+        backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+        return false;
+    }
+    int rejected_status = 0;
+    size_t begin = 0;
+    for (int status : statuses) {
+        size_t end = body.find('\n', body.find('\n', begin) + 1) + 1;
+        if (status == 429 || status >= 500) {
+            retry->append(body, begin, end - begin);
+            ++*retry_docs;
+        } else if (status >= 300) {
+            ++*rejected;
+            rejected_status = status;
+        }
+        begin = end;
+    }
+    if (*rejected > 0) {
+        std::cerr << "[ WARNING ] Elasticsearch rejected " << *rejected << " bulk documents (status "
+                  << rejected_status << ")" << std::endl;
+    }
+    if (*retry_docs > 0) {
+        // The cluster is overloaded; give it time before the next request.
+        retry_at_ = std::chrono::steady_clock::now() + backoff_;
+        backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+    }
+    return true;
+}
+
+bool BulkSink::Post(const std::string &body, std::string *response, int *status) {
+    TraceSpan span("bulk post");
+    bool ok = false;
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addrs = nullptr;
+    if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addrs) == 0) {
+        for (struct addrinfo *a = addrs; a && !ok; a = a->ai_next) {
+            SocketGuard sock{socket(a->ai_family, a->ai_socktype, a->ai_protocol)};
+            if (sock.fd == -1) continue;
+            struct timeval timeout = {kSocketTimeoutSec, 0};
+            setsockopt(sock.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(sock.fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            if (connect(sock.fd, a->ai_addr, a->ai_addrlen) == -1) continue;
+
+            std::string request = "POST " + path_ + " HTTP/1.1\r\n"
+                                  "Host: " + host_ + "\r\n"
+                                  "Content-Type: application/x-ndjson\r\n"
+                                  "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                  "Connection: close\r\n\r\n";
+            if (!SendAll(sock.fd, request.data(), request.size()) ||
+                !SendAll(sock.fd, body.data(), body.size())) {
+                continue;
+            }
+            std::string reply;
+            char buf[4096];
+            ssize_t n;
+            while ((n = recv(sock.fd, buf, sizeof(buf), 0)) > 0) {
+                reply.append(buf, static_cast<size_t>(n));
+            }
+            // "HTTP/1.1 200 OK\r\n<headers>\r\n\r\n<body>"
+            size_t code = reply.find(' ');
+            size_t headers_end = reply.find("\r\n\r\n");
+            if (code != std::string::npos) *status = std::atoi(reply.c_str() + code + 1);
+            ok = code != std::string::npos && code + 1 < reply.size() && reply[code + 1] == '2' &&
+                 headers_end != std::string::npos;
+            if (!ok) continue;
+            std::string headers = reply.substr(0, headers_end);
+            std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+            response->assign(reply, headers_end + 4, std::string::npos);
+            if (headers.find("transfer-encoding: chunked") != std::string::npos) {
+                *response = DecodeChunked(*response);
+            }
+        }
+        freeaddrinfo(addrs);
+    }
+
+    if (ok) {
+        backoff_ = kMinBackoff;
+    } else {
+        retry_at_ = std::chrono::steady_clock::now() + backoff_;
+        backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+    }
+    return ok;
+}
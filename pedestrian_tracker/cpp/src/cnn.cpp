@@ -101,6 +101,11 @@ VectorCNN::VectorCNN(const Config& config,
     result_size_ = std::accumulate(std::next(dims.begin(), 1), dims.end(), 1, std::multiplies<int>());
 }
 
+cv::Size VectorCNN::input_size() const {
+    InferenceEngine::SizeVector dims = input_blob_->getTensorDesc().getDims();
+    return cv::Size(static_cast<int>(dims[3]), static_cast<int>(dims[2]));
+}
+
 void VectorCNN::Compute(const cv::Mat& frame,
                         cv::Mat* vector, cv::Size outp_shape) const {
     std::vector<cv::Mat> output;
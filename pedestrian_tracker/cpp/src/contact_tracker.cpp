@@ -0,0 +1,92 @@
+#include "contact_tracker.hpp"
+
+#include <algorithm>
+
+#include "event_stream.hpp"
+
+namespace {
+uint64_t PairKey(int first_id, int second_id) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(first_id)) << 32) | static_cast<uint32_t>(second_id);
+}
+}  // anonymous namespace
+
+ContactTracker::ContactTracker(const DistanceEstimate &ground, uint64_t max_gap_ms, uint64_t min_duration_ms)
+    : ground_(ground),
+    max_gap_ms_(max_gap_ms),
+    min_duration_ms_(min_duration_ms),
+    stream_(nullptr) {}
+
+void ContactTracker::Update(const PedestrianTracker &tracker, uint64_t timestamp) {
+    TrackedObjects objects;
+    for (const auto &view : tracker.ActiveTracks()) {
+        const Track &track = view.track;
+        if (track.log_id < 0 || track.lost) continue;
+        objects.push_back(track.back());
+        objects.back().object_id = track.log_id;
+    }
+
+    for (const auto &contact : ground_.FindContacts(objects)) {
+        int a = objects[contact.first].object_id;
+        int b = objects[contact.second].object_id;
+        int first_id = std::min(a, b);
+        int second_id = std::max(a, b);
+        uint64_t key = PairKey(first_id, second_id);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            open_.push_back(OpenContact{key, ContactEvent{first_id, second_id, timestamp, timestamp,
+                                                          contact.distance}});
+            index_.emplace(key, std::prev(open_.end()));
+            if (stream_) {
+                stream_->Add(TrackEvent::kContactStart, first_id, second_id, timestamp);
+                stream_->Add(TrackEvent::kContactStart, second_id, first_id, timestamp);
+            }
+            continue;
+        }
+        ContactEvent &event = it->second->event;
+        event.end_time = timestamp;
+        event.min_distance = std::min(event.min_distance, contact.distance);
+        open_.splice(open_.end(), open_, it->second);
+    }
+
+    while (!open_.empty() && open_.front().event.end_time + max_gap_ms_ < timestamp) {
+        End(open_.front().event);
+        index_.erase(open_.front().key);
+        open_.pop_front();
+    }
+}
+
+void ContactTracker::Finish() {
+    for (const auto &contact : open_) {
+        End(contact.event);
+    }
+    open_.clear();
+    index_.clear();
+}
+
+std::vector<ContactEvent> ContactTracker::TakeEvents() {
+    std::vector<ContactEvent> events;
+    events.swap(events_);
+    return events;
+}
+
+void ContactTracker::End(const ContactEvent &event) {
+    if (stream_) {
+        stream_->Add(TrackEvent::kContactEnd, event.first_id, event.second_id, event.end_time);
+        stream_->Add(TrackEvent::kContactEnd, event.second_id, event.first_id, event.end_time);
+    }
+    if (event.end_time - event.start_time < min_duration_ms_) return;
+    events_.push_back(event);
+}
+
+void SaveContactLog(AsyncLogWriter &writer, const std::vector<ContactEvent> &events) {
+    for (const auto &event : events) {
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kContact;
+        record.contact.first_id = event.first_id;
+        record.contact.second_id = event.second_id;
+        record.contact.duration_ms = static_cast<int32_t>(event.end_time - event.start_time);
+        record.contact.min_distance = event.min_distance;
+        record.timestamp = event.start_time;
+        writer.Push(record);
+    }
+}
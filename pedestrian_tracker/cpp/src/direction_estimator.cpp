@@ -0,0 +1,99 @@
+#include "direction_estimator.hpp"
+
+#include <cmath>
+
+namespace {
+// Ground positions are sampled at most this often, so that box jitter
+// between frames doesn't add to the walked distance.
+const uint64_t kSpeedSampleMs = 1000;
+
+float Distance(const cv::Point2f &a, const cv::Point2f &b) {
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+}  // anonymous namespace
+
+DirectionEstimator::DirectionEstimator(const DistanceEstimate *ground)
+    : ground_(ground && ground->HasGroundPlane() ? ground : nullptr),
+    updates_(0) {}
+
+void DirectionEstimator::Update(const PedestrianTracker &tracker) {
+    ++updates_;
+    for (const auto &view : tracker.ActiveTracks()) {
+        const Track &track = view.track;
+        if (track.log_id < 0) continue;
+        auto it = tracks_.find(track.log_id);
+        if (it == tracks_.end()) {
+            TrackState state;
+            state.first = track.first_object;
+            state.last = track.first_object;
+            state.sample = ground_ ? ground_->ToGround(state.first.rect) : cv::Point2f();
+            state.sample_time = state.first.timestamp;
+            state.distance = 0.f;
+            it = tracks_.emplace(track.log_id, state).first;
+        }
+        TrackState &state = it->second;
+        state.seen = updates_;
+        if (track.lost) continue;
+
+        state.last = track.back();
+        if (ground_ && state.last.timestamp >= state.sample_time + kSpeedSampleMs) {
+            cv::Point2f position = ground_->ToGround(state.last.rect);
+            state.distance += Distance(state.sample, position);
+            state.sample = position;
+            state.sample_time = state.last.timestamp;
+        }
+    }
+
+    for (auto it = tracks_.begin(); it != tracks_.end();) {
+        if (it->second.seen != updates_) {
+            FinishTrack(it->first, it->second);
+            it = tracks_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DirectionEstimator::Finish() {
+    for (const auto &pair : tracks_) {
+        FinishTrack(pair.first, pair.second);
+    }
+    tracks_.clear();
+}
+
+std::vector<DirectionEntry> DirectionEstimator::TakeFinished() {
+    std::vector<DirectionEntry> finished;
+    finished.swap(finished_);
+    return finished;
+}
+
+void DirectionEstimator::FinishTrack(int id, const TrackState &state) {
+    // A single position has no direction.
+    if (state.last.frame_idx == state.first.frame_idx) return;
+
+    DirectionEntry entry;
+    entry.object_id = id;
+    entry.timestamp = state.first.timestamp;
+    entry.direction = GetMoveDirection(state.first.rect.tl(), state.last.rect.tl());
+    entry.speed = -1.f;
+    if (ground_ && state.last.timestamp > state.first.timestamp) {
+        float distance = state.distance;
+        if (state.last.timestamp > state.sample_time) {
+            distance += Distance(state.sample, ground_->ToGround(state.last.rect));
+        }
+        entry.speed = distance * 1000.f / static_cast<float>(state.last.timestamp - state.first.timestamp);
+    }
+    finished_.push_back(entry);
+}
+
+void SaveDirectionLog(AsyncLogWriter &writer, const std::vector<DirectionEntry> &entries) {
+    for (const auto &entry : entries) {
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kDirection;
+        record.direction.object_id = entry.object_id;
+        record.direction.direction = static_cast<uint8_t>(entry.direction);
+        record.direction.speed = entry.speed;
+        record.timestamp = entry.timestamp;
+        writer.Push(record);
+    }
+}
@@ -4,10 +4,47 @@
 #include <opencv2/imgproc.hpp>
 #include "core.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include "distance_estimate.hpp"
 #include "utils.hpp"
 
+namespace {
+// Ground point of a box together with the grid cell it falls into.
+struct GridEntry {
+    int cx;
+    int cy;
+    size_t index;
+};
+
+bool CellLess(const GridEntry &a, const GridEntry &b) {
+    return a.cy != b.cy ? a.cy < b.cy : a.cx < b.cx;
+}
+
+bool SameCell(const GridEntry &a, const GridEntry &b) {
+    return a.cx == b.cx && a.cy == b.cy;
+}
+
+int CellOf(float value, float cell_size) {
+    // Points near the horizon map far away; clamping keeps the cell indices
+    // and their neighbors in range, such points are never close anyway.
+    const double limit = 1 << 30;
+    double cell = std::floor(static_cast<double>(value) / cell_size);
+    return static_cast<int>(std::max(-limit, std::min(limit, cell)));
+}
+
+// Union-find with path halving and union by size.
+size_t FindRoot(std::vector<size_t> *parent, size_t i) {
+    while ((*parent)[i] != i) {
+        (*parent)[i] = (*parent)[(*parent)[i]];
+        i = (*parent)[i];
+    }
+    return i;
+}
+}  // anonymous namespace
+
 DistanceEstimate::DistanceEstimate(cv::Mat& video_frame):frame(video_frame){}
 DistanceEstimate::DistanceEstimate(cv::Mat& video_frame, std::vector<cv::Point2f> config_points,float threshold):frame(video_frame){
 
@@ -46,23 +83,113 @@ DistanceEstimate& DistanceEstimate::operator=(const DistanceEstimate &other){
     threshold_ = other.threshold_;
     return *this;
 }
-std::vector<cv::Point2f> DistanceEstimate::GetTransformedPoints(const TrackedObjects &boxes){
+bool DistanceEstimate::HasGroundPlane() const{
+    return !perspective_tran.empty();
+}
+cv::Point2f DistanceEstimate::ToGround(const cv::Rect &box) const{
+    std::vector<cv::Point2f> pnt(1, GetBottomPoint(box));
+    std::vector<cv::Point2f> bd_pnt(1);
+    perspectiveTransform(pnt, bd_pnt, perspective_tran);
+    return ToMeters(bd_pnt[0]);
+}
+cv::Point2f DistanceEstimate::ToMeters(const cv::Point2f &warped) const{
+    //getting the pixel ratio for 150cm = 1.5m
+    return cv::Point2f(warped.x / distance_w * 1.5f, warped.y / distance_h * 1.5f);
+}
+std::vector<cv::Point2f> DistanceEstimate::GetTransformedPoints(const TrackedObjects &boxes) const{
     std::vector<cv::Point2f> bottom_points;
-	for (unsigned int i = 0; i < boxes.size(); i++) {
-		std::vector<cv::Point2f> temp_pnt(1); 
-		std::vector<cv::Point2f> bd_pnt(1);
-        temp_pnt[0] = GetBottomPoint(boxes[i].rect);
-		// circle(frame, temp_pnt[0], 
-        // 5, 
-        // cv::Scalar(0, 0, 255),
-        // 5);
-		perspectiveTransform(temp_pnt, bd_pnt,perspective_tran);
-		temp_pnt[0] = cv::Point2f(bd_pnt[0].x, bd_pnt[0].y);
-		bottom_points.push_back(temp_pnt[0]);
-		
-	}
-	
-	return bottom_points;
+    if (boxes.empty()) {
+        return bottom_points;
+    }
+    bottom_points.reserve(boxes.size());
+    for (const auto &box : boxes) {
+        bottom_points.push_back(GetBottomPoint(box.rect));
+    }
+    std::vector<cv::Point2f> warped;
+    perspectiveTransform(bottom_points, warped, perspective_tran);
+    for (size_t i = 0; i < warped.size(); i++) {
+        bottom_points[i] = ToMeters(warped[i]);
+    }
+    return bottom_points;
+}
+std::vector<CloseContact> DistanceEstimate::FindContacts(const TrackedObjects &boxes) const{
+    std::vector<CloseContact> contacts;
+    std::vector<cv::Point2f> points = GetTransformedPoints(boxes);
+    if (points.size() < 2) {
+        return contacts;
+    }
+    // Two points closer than the threshold are in the same or in adjacent cells.
+    const float cell_size = std::max(threshold_, 1e-3f);
+    const float max_dist_sq = threshold_ * threshold_;
+    std::vector<GridEntry> grid;
+    grid.reserve(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        // Points on the horizon line warp to infinity or NaN and have no
+        // cell; they are not close to anything.
+        if (!std::isfinite(points[i].x) || !std::isfinite(points[i].y)) continue;
+        grid.push_back(GridEntry{CellOf(points[i].x, cell_size), CellOf(points[i].y, cell_size), i});
+    }
+    std::sort(grid.begin(), grid.end(), CellLess);
+
+    auto check = [&](size_t i, size_t j) {
+        cv::Point2f d = points[i] - points[j];
+        float dist_sq = d.x * d.x + d.y * d.y;
+        if (dist_sq <= max_dist_sq) {
+            contacts.push_back(CloseContact{std::min(i, j), std::max(i, j), std::sqrt(dist_sq)});
+        }
+    };
+    // Half of the 8-neighborhood: right, below-left, below, below-right. These
+    // cells sort after the current one, so every pair of cells is seen once.
+    static const int kOffsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    for (size_t begin = 0; begin < grid.size();) {
+        size_t end = begin + 1;
+        while (end < grid.size() && SameCell(grid[end], grid[begin])) {
+            ++end;
+        }
+        for (size_t a = begin; a < end; a++) {
+            for (size_t b = a + 1; b < end; b++) {
+                check(grid[a].index, grid[b].index);
+            }
+        }
+        for (const auto &offset : kOffsets) {
+            GridEntry key{grid[begin].cx + offset[0], grid[begin].cy + offset[1], 0};
+            auto range = std::equal_range(grid.begin() + end, grid.end(), key, CellLess);
+            for (size_t a = begin; a < end; a++) {
+                for (auto it = range.first; it != range.second; ++it) {
+                    check(grid[a].index, it->index);
+                }
+            }
+        }
+        begin = end;
+    }
+    return contacts;
+}
+std::vector<std::vector<size_t>> DistanceEstimate::GroupContacts(size_t count, const std::vector<CloseContact> &contacts){
+    std::vector<size_t> parent(count);
+    std::vector<size_t> size(count, 1);
+    for (size_t i = 0; i < count; i++) {
+        parent[i] = i;
+    }
+    for (const auto &contact : contacts) {
+        size_t a = FindRoot(&parent, contact.first);
+        size_t b = FindRoot(&parent, contact.second);
+        if (a == b) continue;
+        if (size[a] < size[b]) std::swap(a, b);
+        parent[b] = a;
+        size[a] += size[b];
+    }
+    std::vector<std::vector<size_t>> groups;
+    std::vector<size_t> group_of(count, std::numeric_limits<size_t>::max());
+    for (size_t i = 0; i < count; i++) {
+        size_t root = FindRoot(&parent, i);
+        if (size[root] < 2) continue;
+        if (group_of[root] == std::numeric_limits<size_t>::max()) {
+            group_of[root] = groups.size();
+            groups.emplace_back();
+        }
+        groups[group_of[root]].push_back(i);
+    }
+    return groups;
 }
 cv::Point DistanceEstimate::GetMiddle(const cv::Point2f &point_1, const cv::Point2f &point_2) {
 	cv::Point result;
@@ -71,45 +198,41 @@ cv::Point DistanceEstimate::GetMiddle(const cv::Point2f &point_1, const cv::Poin
 	return result;
 }
 void DistanceEstimate::DrawDistance(const TrackedObjects &boxes) {
-    std::vector<std::pair<TrackedObjects, float>> distances_mat;
-    std::vector<cv::Point2f> detected_pts;
-    detected_pts = GetTransformedPoints(boxes);
-    distances_mat = EstimateDistAllObj(detected_pts,boxes);
-	if (distances_mat.size() > 1) {
-		for (unsigned int i = 0; i < distances_mat.size(); i++) {
-			cv::Rect pp1;
-			cv::Rect pp2;
-			float dist = 0;
-			//float mark1_w, mark2_w;
-			//float mark1_h, mark2_h;
-			cv::Point pp1_center, pp2_center;
-            pp1 = distances_mat[i].first[0].rect;
-            pp2 = distances_mat[i].first[1].rect;
-            pp1_center.x = (pp1.x + (pp1.x+pp1.width))/2;
-            pp1_center.y = (pp1.y + (pp1.y+pp1.height))/2;
-            pp2_center.x = (pp2.x + (pp2.x+pp2.width))/2;
-            pp2_center.y = (pp2.y + (pp2.y+pp2.height))/2;
-            dist = distances_mat[i].second;
-            
-            dist = ceilf(dist * 100)/100;
-            std::string dist_str = std::to_string(dist);
-            dist_str.erase(dist_str.find_last_not_of('0')+1,std::string::npos);
-            cv::line(frame,
-                pp1_center,
-                pp2_center,
-                cv::Scalar(0, 255, 0),
-                2		
-            );
-            cv::putText(frame, //target image
-                dist_str + "m",
-                GetMiddle(pp1_center, pp2_center),
-                cv::FONT_HERSHEY_DUPLEX,
-                1.0,
-                CV_RGB(118, 185, 0), //font color
-                1);
-            
-		}	
-	}
+    std::vector<CloseContact> contacts = FindContacts(boxes);
+    for (const auto &contact : contacts) {
+        const cv::Rect &pp1 = boxes[contact.first].rect;
+        const cv::Rect &pp2 = boxes[contact.second].rect;
+        cv::Point pp1_center(pp1.x + pp1.width / 2, pp1.y + pp1.height / 2);
+        cv::Point pp2_center(pp2.x + pp2.width / 2, pp2.y + pp2.height / 2);
+
+        float dist = ceilf(contact.distance * 100)/100;
+        std::string dist_str = std::to_string(dist);
+        dist_str.erase(dist_str.find_last_not_of('0')+1,std::string::npos);
+        cv::line(frame,
+            pp1_center,
+            pp2_center,
+            cv::Scalar(0, 255, 0),
+            2
+        );
+        cv::putText(frame, //target image
+            dist_str + "m",
+            GetMiddle(pp1_center, pp2_center),
+            cv::FONT_HERSHEY_DUPLEX,
+            1.0,
+            CV_RGB(118, 185, 0), //font color
+            1);
+    }
+    // Pairs already have their line; larger groups are framed as a whole.
+    for (const auto &group : GroupContacts(boxes.size(), contacts)) {
+        if (group.size() < 3) continue;
+        cv::Rect area = boxes[group[0]].rect;
+        for (size_t i = 1; i < group.size(); i++) {
+            area |= boxes[group[i]].rect;
+        }
+        cv::rectangle(frame, area, cv::Scalar(0, 0, 255), 2);
+        cv::putText(frame, std::to_string(group.size()) + " people", area.tl() + cv::Point(0, -5),
+                    cv::FONT_HERSHEY_DUPLEX, 0.8, cv::Scalar(0, 0, 255), 1);
+    }
 }
 float DistanceEstimate::CalculateDist(const cv::Point2f &point_1, const cv::Point2f &point_2){
     float dist;
@@ -120,37 +243,3 @@ float DistanceEstimate::CalculateDist(const cv::Point2f &point_1, const cv::Poin
 	dist = sqrt(x + y);
 	return dist;
 }
-float DistanceEstimate::EstimateRealDist(const cv::Point2f &point_1, const cv::Point2f &point_2, const float &distance_w, const float &distance_h)const {
-    float x, y,dist_y,dist_x;
-	float result;
-	y = abs(point_1.y - point_2.y);
-	x = abs(point_1.x - point_2.x);
-    //getting the pixel ratio for 150cm = 1.5m
-	dist_y = (float)(y / distance_h) * 150;
-	dist_x = (float)(x / distance_w) * 150;
-
-	result = (float)sqrtf((powf(dist_x, 2) + powf(dist_y, 2)));
-    //convert cm to m
-    result = result/100;
-	return result;
-}
-
-std::vector<std::pair<TrackedObjects, float>> DistanceEstimate::EstimateDistAllObj(const std::vector<cv::Point2f> &detected_pts,const TrackedObjects &boxes){
-
-    std::vector<std::pair<TrackedObjects, float>> bxs;
-    for (unsigned int i = 0; i < detected_pts.size(); i++) {
-        for (unsigned int j = 0; j < detected_pts.size(); j++) {
-            if (i != j) {
-                float dist = 0.0f;
-                dist = EstimateRealDist(detected_pts[i], detected_pts[j], distance_w, distance_h);  
-                if (dist <=threshold_){
-                    bxs.push_back(make_pair((TrackedObjects){boxes[i],boxes[j]},dist));      
-                }else{
-                    continue;
-                }
-                
-            }
-        }
-    }
-    return bxs;
-}
\ No newline at end of file
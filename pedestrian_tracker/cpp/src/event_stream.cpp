@@ -0,0 +1,123 @@
+#include "event_stream.hpp"
+
+#include <cmath>
+
+#include "utils.hpp"
+
+namespace {
+float Distance(const cv::Point2f &a, const cv::Point2f &b) {
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+}  // anonymous namespace
+
+const char *TrackEventName(TrackEvent::Type type) {
+    switch (type) {
+    case TrackEvent::kTrackStart: return "track_start";
+    case TrackEvent::kTrackEnd: return "track_end";
+    case TrackEvent::kZoneEnter: return "zone_enter";
+    case TrackEvent::kZoneExit: return "zone_exit";
+    case TrackEvent::kLineIn: return "line_in";
+    case TrackEvent::kLineOut: return "line_out";
+    case TrackEvent::kContactStart: return "contact_start";
+    default: return "contact_end";
+    }
+}
+
+EventStream::EventStream() : updates_(0) {}
+
+void EventStream::Update(const PedestrianTracker &tracker) {
+    ++updates_;
+    for (const auto &view : tracker.ActiveTracks()) {
+        const Track &track = view.track;
+        if (track.log_id < 0) continue;
+        cv::Point2f bottom = GetBottomPoint(track.back().rect);
+        auto it = tracks_.find(track.log_id);
+        if (it == tracks_.end()) {
+            TrackState state;
+            state.summary.first = GetBottomPoint(track.first_object.rect);
+            state.summary.last = bottom;
+            state.summary.start_time = track.first_object.timestamp;
+            state.summary.last_time = track.back().timestamp;
+            state.summary.positions = static_cast<uint32_t>(track.length);
+            state.summary.path = Distance(bottom, state.summary.first);
+            state.ended = false;
+            it = tracks_.emplace(track.log_id, state).first;
+            events_.push_back(TrackEvent{TrackEvent::kTrackStart, track.log_id, -1,
+                                         state.summary.start_time, state.summary});
+        }
+        TrackState &state = it->second;
+        state.seen = updates_;
+        if (track.lost || track.back().timestamp == state.summary.last_time) continue;
+
+        state.summary.path += Distance(bottom, state.summary.last);
+        state.summary.last = bottom;
+        state.summary.last_time = track.back().timestamp;
+        state.summary.positions = static_cast<uint32_t>(track.length);
+    }
+
+    for (auto &event : held_) {
+        auto it = tracks_.find(event.object_id);
+        if (it == tracks_.end()) continue;
+        event.summary = it->second.summary;
+        events_.push_back(event);
+    }
+    held_.clear();
+
+    for (auto &pair : tracks_) {
+        if (pair.second.seen != updates_ && !pair.second.ended) {
+            pair.second.ended = true;
+            ended_.push_back(pair.first);
+        }
+    }
+}
+
+void EventStream::Add(TrackEvent::Type type, int object_id, int other, uint64_t timestamp) {
+    auto it = tracks_.find(object_id);
+    if (it == tracks_.end()) {
+        held_.push_back(TrackEvent{type, object_id, other, timestamp, TrackSummary()});
+        return;
+    }
+    events_.push_back(TrackEvent{type, object_id, other, timestamp, it->second.summary});
+}
+
+void EventStream::Finish() {
+    for (auto &pair : tracks_) {
+        if (!pair.second.ended) {
+            pair.second.ended = true;
+            ended_.push_back(pair.first);
+        }
+    }
+}
+
+std::vector<TrackEvent> EventStream::TakeEvents() {
+    for (int id : ended_) {
+        auto it = tracks_.find(id);
+        const TrackSummary &summary = it->second.summary;
+        events_.push_back(TrackEvent{TrackEvent::kTrackEnd, id, -1, summary.last_time, summary});
+        tracks_.erase(it);
+    }
+    ended_.clear();
+    std::vector<TrackEvent> events;
+    events.swap(events_);
+    return events;
+}
+
+void SaveEventLog(AsyncLogWriter &writer, const std::vector<TrackEvent> &events) {
+    for (const auto &event : events) {
+        const TrackSummary &summary = event.summary;
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kEvent;
+        record.event.type = event.type;
+        record.event.object_id = event.object_id;
+        record.event.other = event.other;
+        record.event.first_x = cvRound(summary.first.x);
+        record.event.first_y = cvRound(summary.first.y);
+        record.event.last_x = cvRound(summary.last.x);
+        record.event.last_y = cvRound(summary.last.y);
+        record.event.age_ms = static_cast<int32_t>(summary.last_time - summary.start_time);
+        record.event.positions = static_cast<int32_t>(summary.positions);
+        record.event.path = summary.path;
+        record.timestamp = event.timestamp;
+        writer.Push(record);
+    }
+}
@@ -0,0 +1,118 @@
+#include "line_counter.hpp"
+
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+#include "event_stream.hpp"
+#include "utils.hpp"
+
+namespace {
+// Positive if b is on the right-hand side of o->a in image coordinates.
+float Cross(const cv::Point2f &o, const cv::Point2f &a, const cv::Point2f &b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+}  // anonymous namespace
+
+LineCounter::LineCounter(const std::vector<CountingLine> &lines, uint64_t bucket_ms)
+    : lines_(lines),
+    bucket_ms_(bucket_ms > 0 ? bucket_ms : 1),
+    bucket_start_(0),
+    bucket_open_(false),
+    totals_(lines.size(), std::pair<uint64_t, uint64_t>(0, 0)),
+    stream_(nullptr) {
+    current_.resize(lines_.size());
+    for (size_t i = 0; i < lines_.size(); i++) {
+        current_[i] = LineCount{0, static_cast<int>(i), 0, 0};
+    }
+}
+
+void LineCounter::Advance(uint64_t timestamp) {
+    uint64_t bucket_start = timestamp - timestamp % bucket_ms_;
+    if (bucket_open_ && bucket_start == bucket_start_) return;
+    // Buckets without frames are skipped, not reported as zero.
+    if (bucket_open_) CloseBucket();
+    bucket_start_ = bucket_start;
+    bucket_open_ = true;
+    for (auto &count : current_) {
+        count.bucket_start = bucket_start;
+    }
+}
+
+void LineCounter::Step(const cv::Point2f &from, const cv::Point2f &to, int object_id, uint64_t timestamp) {
+    for (size_t i = 0; i < lines_.size(); i++) {
+        const CountingLine &line = lines_[i];
+        // A point on the line belongs to the left side, so a track that
+        // stops on the line and walks on is counted once.
+        bool right_from = Cross(line.a, line.b, from) > 0;
+        bool right_to = Cross(line.a, line.b, to) > 0;
+        if (right_from == right_to) continue;
+        // The step crosses the infinite line; it counts only between a and b.
+        float side_a = Cross(from, to, line.a);
+        float side_b = Cross(from, to, line.b);
+        if ((side_a > 0 && side_b > 0) || (side_a < 0 && side_b < 0)) continue;
+        if (right_to) {
+            current_[i].in++;
+            totals_[i].first++;
+        } else {
+            current_[i].out++;
+            totals_[i].second++;
+        }
+        if (stream_) {
+            stream_->Add(right_to ? TrackEvent::kLineIn : TrackEvent::kLineOut, object_id, static_cast<int>(i),
+                         timestamp);
+        }
+    }
+}
+
+std::vector<LineCount> LineCounter::TakeCounts(bool flush) {
+    if (flush && bucket_open_) {
+        CloseBucket();
+        bucket_open_ = false;
+    }
+    std::vector<LineCount> counts;
+    counts.swap(finished_);
+    return counts;
+}
+
+void LineCounter::CloseBucket() {
+    for (auto &count : current_) {
+        finished_.push_back(count);
+        count.in = count.out = 0;
+    }
+}
+
+void LineCounter::Draw(cv::Mat *frame) const {
+    const cv::Scalar color(0, 200, 255);
+    for (size_t i = 0; i < lines_.size(); i++) {
+        const CountingLine &line = lines_[i];
+        cv::line(*frame, line.a, line.b, color, 2);
+        std::string label = std::to_string(i) + ": in " + std::to_string(totals_[i].first) +
+                            " out " + std::to_string(totals_[i].second);
+        cv::putText(*frame, label, line.a, cv::FONT_HERSHEY_SIMPLEX, 0.7, color, 2);
+    }
+}
+
+void SaveLineCounts(AsyncLogWriter &writer, const std::vector<LineCount> &counts) {
+    for (const auto &count : counts) {
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kLineCount;
+        record.lines.line = count.line;
+        record.lines.in = count.in;
+        record.lines.out = count.out;
+        record.timestamp = count.bucket_start;
+        writer.Push(record);
+    }
+}
+
+std::vector<CountingLine> ReadLineConfig(const std::string &path) {
+    std::vector<cv::Point2f> points = ReadConfigPoints(path);
+    if (points.size() % 2 != 0) {
+        throw std::runtime_error("line config file should have two points per line (" + path + ")");
+    }
+    std::vector<CountingLine> lines;
+    for (size_t i = 0; i < points.size(); i += 2) {
+        lines.push_back(CountingLine{points[i], points[i + 1]});
+    }
+    return lines;
+}
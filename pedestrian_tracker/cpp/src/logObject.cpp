@@ -8,56 +8,31 @@
 #include "logObject.hpp"
 
     //Split Log into relivant fields
-   LogInformation::LogInformation(std::stringstream &log){
-        int i=0;
-   
-        //int x_Location, y_Location, x_box, y_box, confidence;
-        while(getline(log, segment, ','))
-            {   
-            
-            switch (i)
-            {
-            case 0:
-                frameNumber = segment;
-                i++;
-                break;
-            case 1:
-                dateTime = segment;
-                i++;
-                break;
-            case 2:
-                uniqueID = stoi(segment);
-                i++;
-                break;
-            case 3:
-                x_Location = stoi(segment);
-                i++;
-                break;
-            case 4:
-                y_Location = stoi(segment);
-                i++;
-                break;
-            case 5:
-                x_box = stoi(segment);
-                i++;
-                break;
-            case 6:
-                y_box = stoi(segment);
-                i++;
-                break;
-            case 7:
-                confidence = stoi(segment);
-                i++;
-                break;
-            case 8:
-                location = segment;
-                i++;
-                break;
-            
-            default:
-                break;
-            }
-               //seglist.push_back(segment);
-        }
-    };
+   LogInformation::LogInformation(const CsvReader &row)
+        : x_Location(0),
+          y_Location(0),
+          x_box(0),
+          y_box(0),
+          confidence(0),
+          uniqueID(0) {
+        if (row.size() > 0) frameNumber = row.field(0).str();
+        if (row.size() > 1) dateTime = row.field(1).str();
+        row.Int(2, &uniqueID);
+        row.Int(3, &x_Location);
+        row.Int(4, &y_Location);
+        row.Int(5, &x_box);
+        row.Int(6, &y_box);
+        row.Float(7, &confidence);
+        if (row.size() > 8) location = row.field(8).str();
+    }
 
+   LogInformation::LogInformation(const TrajRow &row, const std::string &location)
+        : frameNumber(std::to_string(row.frame_idx)),
+          dateTime(FormatAscTime(row.timestamp)),
+          location(location),
+          x_Location(row.x),
+          y_Location(row.y),
+          x_box(row.width),
+          y_box(row.height),
+          confidence(row.confidence),
+          uniqueID(row.object_id) {}
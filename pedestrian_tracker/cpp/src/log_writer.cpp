@@ -0,0 +1,552 @@
+#include "log_writer.hpp"
+#include "event_stream.hpp"
+#include "trace_recorder.hpp"
+#include "utils.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+// Inserts the local time before the extension of the path:
+// "logs/a-roi.csv" -> "logs/a-roi-20210823-133727.csv".
+std::string SegmentPath(const std::string &path) {
+    size_t slash = path.rfind('/');
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+
+    time_t now = time(nullptr);
+    struct tm local;
+    char stamp[32];
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "-%Y%m%d-%H%M%S", &local);
+
+    std::string base = path.substr(0, dot) + stamp;
+    std::string ext = path.substr(dot);
+    std::string segment = base + ext;
+    for (int i = 1; access(segment.c_str(), F_OK) == 0 || access((segment + ".gz").c_str(), F_OK) == 0; i++) {
+        segment = base + "-" + std::to_string(i) + ext;
+    }
+    return segment;
+}
+
+void GzipFile(const std::string &path) {
+    std::string gz_path = path + ".gz";
+    std::string tmp_path = gz_path + ".tmp";
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    gzFile out = gzopen(tmp_path.c_str(), "wb6");
+    if (!out) {
+        throw std::runtime_error("Can't open " + tmp_path);
+    }
+    std::vector<char> buf(1 << 16);
+    bool ok = true;
+    while (ok && in) {
+        in.read(buf.data(), buf.size());
+        std::streamsize n = in.gcount();
+        if (n > 0) ok = gzwrite(out, buf.data(), static_cast<unsigned>(n)) == n;
+    }
+    ok = (gzclose(out) == Z_OK) && ok && !in.bad();
+    if (!ok || rename(tmp_path.c_str(), gz_path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        throw std::runtime_error("Can't compress " + path);
+    }
+    unlink(path.c_str());
+}
+}  // anonymous namespace
+
+LogFileWriter::LogFileWriter(const std::string &path,
+                             std::chrono::milliseconds sync_interval,
+                             size_t block_size,
+                             bool truncate,
+                             const LogRotation &rotation)
+    : path_(path),
+    fd_(-1),
+    block_size_(block_size),
+    sync_interval_(sync_interval),
+    last_sync_(Clock::now()),
+    bytes_written_(0),
+    rotation_(rotation),
+    segment_bytes_(0) {
+    Open(truncate);
+    buffer_.reserve(block_size_);
+}
+
+void LogFileWriter::Open(bool truncate) {
+    fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    if (fd_ == -1) {
+        throw std::runtime_error("Can't open log file (" + path_ + "): " + strerror(errno));
+    }
+    struct stat info;
+    segment_bytes_ = fstat(fd_, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    segment_start_ = Clock::now();
+}
+
+LogFileWriter::~LogFileWriter() {
+    try {
+        Flush();
+    } catch (const std::exception &) {
+        // Nothing can be reported from a destructor.
+    }
+    if (fd_ != -1) close(fd_);
+}
+
+void LogFileWriter::Write(const std::string &rows) {
+    buffer_ += rows;
+    if (buffer_.size() >= block_size_) {
+        WriteBuffer();
+    }
+    if (Clock::now() - last_sync_ >= sync_interval_) {
+        Flush();
+    }
+}
+
+void LogFileWriter::Flush() {
+    WriteBuffer();
+    if (fsync(fd_) == -1) {
+        throw std::runtime_error("Can't sync log file (" + path_ + "): " + strerror(errno));
+    }
+    last_sync_ = Clock::now();
+}
+
+bool LogFileWriter::RotationDue() const {
+    return (rotation_.max_bytes > 0 && size() >= rotation_.max_bytes) ||
+           (rotation_.max_age.count() > 0 && Clock::now() - segment_start_ >= rotation_.max_age);
+}
+
+std::string LogFileWriter::Rotate(const std::string &last_rows) {
+    // The open descriptor follows the rename, so the segment is completed
+    // through it once the new file exists. On failure the segment is moved
+    // back and stays the current file.
+    std::string segment = SegmentPath(path_);
+    if (rename(path_.c_str(), segment.c_str()) != 0) {
+        throw std::runtime_error("Can't rotate log file (" + path_ + "): " + strerror(errno));
+    }
+    int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::string error = strerror(errno);
+        rename(segment.c_str(), path_.c_str());
+        throw std::runtime_error("Can't rotate log file (" + path_ + "): " + error);
+    }
+    size_t rows = buffer_.size();
+    buffer_ += last_rows;
+    try {
+        Flush();
+    } catch (...) {
+        if (buffer_.size() == rows + last_rows.size()) buffer_.resize(rows);
+        close(fd);
+        rename(segment.c_str(), path_.c_str());
+        throw;
+    }
+    close(fd_);
+    fd_ = fd;
+    segment_bytes_ = 0;
+    segment_start_ = Clock::now();
+    return segment;
+}
+
+void LogFileWriter::WriteBuffer() {
+    const char *data = buffer_.data();
+    size_t left = buffer_.size();
+    while (left > 0) {
+        ssize_t written = write(fd_, data, left);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Can't write log file (" + path_ + "): " + strerror(errno));
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+    bytes_written_ += buffer_.size();
+    segment_bytes_ += buffer_.size();
+    buffer_.clear();
+}
+
+LogCompressor::LogCompressor(std::chrono::seconds delay) : delay_(delay), stop_(false) {
+    thread_ = std::thread(&LogCompressor::Run, this);
+}
+
+LogCompressor::~LogCompressor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void LogCompressor::Compress(const std::string &path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(Segment{path, Clock::now() + delay_});
+    }
+    cond_.notify_one();
+}
+
+void LogCompressor::Run() {
+    TraceRecorder::SetThreadName("log compressor");
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (queue_.empty()) {
+            if (stop_) break;
+            cond_.wait(lock);
+            continue;
+        }
+        // Segments are queued in rotation order, so the front is due first.
+        Clock::time_point due = queue_.front().due;
+        if (Clock::now() < due) {
+            if (stop_) break;
+            cond_.wait_until(lock, due);
+            continue;
+        }
+        std::string path = queue_.front().path;
+        queue_.pop_front();
+        lock.unlock();
+        try {
+            TraceSpan span("gzip");
+            GzipFile(path);
+        } catch (const std::exception &error) {
+            // The segment stays uncompressed, nothing is lost.
+            std::cerr << "[ WARNING ] " << error.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+AsyncLogWriter::AsyncLogWriter(LogFiles logs,
+                               const std::string &location,
+                               const std::string &uuid,
+                               size_t capacity,
+                               bool binary,
+                               std::unique_ptr<BulkSink> sink,
+                               std::chrono::seconds compress_delay)
+    : queue_(capacity),
+    logs_(std::move(logs)),
+    sink_(std::move(sink)),
+    binary_(binary),
+    stop_(false),
+    high_water_mark_(0),
+    dropped_(0),
+    compressor_(compress_delay) {
+    header_.location = location;
+    header_.uuid = uuid;
+    header_.start_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    thread_ = std::thread(&AsyncLogWriter::Run, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+    try {
+        Close();
+    } catch (const std::exception &) {
+        // Nothing can be reported from a destructor.
+    }
+}
+
+bool AsyncLogWriter::Push(const LogRecord &record) {
+    if (!queue_.TryPush(record)) {
+        dropped_++;
+        return false;
+    }
+    size_t size = queue_.size();
+    if (size > high_water_mark_) high_water_mark_ = size;
+    return true;
+}
+
+void AsyncLogWriter::Close() {
+    if (thread_.joinable()) {
+        stop_ = true;
+        thread_.join();
+    }
+    if (sink_) sink_->Close();
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+std::string AsyncLogWriter::ZoneName(int zone) const {
+    return static_cast<size_t>(zone) < zone_names_.size() ? zone_names_[zone] : std::to_string(zone);
+}
+
+void AsyncLogWriter::Format(const LogRecord &r, TrajLogEncoder *encoder, std::string *row,
+                            std::string *doc) const {
+    if (r.kind == LogRecord::kTrajectory) {
+        const LogRecord::Trajectory &t = r.trajectory;
+        TrajRow traj_row;
+        traj_row.frame_idx = t.frame_idx;
+        traj_row.object_id = t.object_id;
+        traj_row.x = t.x;
+        traj_row.y = t.y;
+        traj_row.width = t.width;
+        traj_row.height = t.height;
+        traj_row.confidence = t.confidence;
+        traj_row.timestamp = r.timestamp;
+        if (binary_) {
+            encoder->Add(traj_row, row);
+        } else {
+            AppendTrajRowCsv(header_, traj_row, row);
+        }
+        if (doc) AppendTrajRowJson(header_, traj_row, doc);
+        return;
+    }
+
+    const std::string time = FormatAscTime(r.timestamp);
+    char number[32];
+    switch (r.kind) {
+    case LogRecord::kRoi: {
+        const LogRecord::Roi &roi = r.roi;
+        // Formatted like an ostream formats a float.
+        snprintf(number, sizeof(number), "%g", static_cast<float>(roi.stay_ms) / 1000);
+        *row += std::to_string(roi.object_id) + ',' + time + ',' + number + ',' + header_.location + '\n';
+        if (doc) {
+            // Field names of the roi pipeline in logstash_AI.conf.
+            *doc += "{\"person\":" + std::to_string(roi.object_id) + ",\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"roi_duration\":" + std::to_string(static_cast<float>(roi.stay_ms) / 1000) +
+                    ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kDirection: {
+        const LogRecord::Direction &dir = r.direction;
+        const char *direction = MoveDirectionName(static_cast<MoveDirection>(dir.direction));
+        // The speed column is only written when it is known.
+        number[0] = '\0';
+        if (dir.speed >= 0) snprintf(number, sizeof(number), ",%.2f", dir.speed);
+        *row += time + ',' + std::to_string(dir.object_id) + ',' + direction + ',' + header_.location + number +
+                '\n';
+        if (doc) {
+            // Field names of the directions pipeline in logstash_AI.conf.
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"person\":" + std::to_string(dir.object_id) + ",\"direction\":\"" + direction +
+                    "\",\"location\":";
+            AppendJsonString(header_.location, doc);
+            if (dir.speed >= 0) *doc += ",\"speed\":" + std::string(number + 1);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kLineCount: {
+        const LogRecord::LineCrossings &lines = r.lines;
+        *row += time + ',' + std::to_string(lines.line) + ',' + std::to_string(lines.in) + ',' +
+                std::to_string(lines.out) + ',' + header_.location + '\n';
+        if (doc) {
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"line\":" + std::to_string(lines.line) + ",\"in\":" + std::to_string(lines.in) +
+                    ",\"out\":" + std::to_string(lines.out) + ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kZone: {
+        const LogRecord::ZoneVisit &visit = r.zone;
+        const std::string zone = ZoneName(visit.zone);
+        std::string dwell = std::to_string(static_cast<float>(visit.stay_ms) / 1000);
+        *row += time + ',' + std::to_string(visit.object_id) + ',' + zone + ',' + dwell + ',' + header_.location +
+                '\n';
+        if (doc) {
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"person\":" + std::to_string(visit.object_id) + ",\"zone\":";
+            AppendJsonString(zone, doc);
+            *doc += ",\"dwell\":" + dwell + ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kFlow: {
+        const LogRecord::ZoneFlow &flow = r.flow;
+        const std::string origin = ZoneName(flow.origin);
+        const std::string destination = ZoneName(flow.destination);
+        *row += time + ',' + origin + ',' + destination + ',' + std::to_string(flow.count) + ',' +
+                header_.location + '\n';
+        if (doc) {
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"origin\":";
+            AppendJsonString(origin, doc);
+            *doc += ",\"destination\":";
+            AppendJsonString(destination, doc);
+            *doc += ",\"count\":" + std::to_string(flow.count) + ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kContact: {
+        const LogRecord::Contact &contact = r.contact;
+        std::string duration = std::to_string(static_cast<float>(contact.duration_ms) / 1000);
+        snprintf(number, sizeof(number), "%.2f", contact.min_distance);
+        *row += time + ',' + std::to_string(contact.first_id) + ',' + std::to_string(contact.second_id) + ',' +
+                duration + ',' + number + ',' + header_.location + '\n';
+        if (doc) {
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"person1\":" + std::to_string(contact.first_id) + ",\"person2\":" +
+                    std::to_string(contact.second_id) + ",\"duration\":" + duration + ",\"min_distance\":" +
+                    number + ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kEvent: {
+        const LogRecord::Event &e = r.event;
+        const char *event = TrackEventName(static_cast<TrackEvent::Type>(e.type));
+        std::string age = std::to_string(static_cast<float>(e.age_ms) / 1000);
+        snprintf(number, sizeof(number), "%.1f", e.path);
+        std::string summary = std::to_string(e.first_x) + ',' + std::to_string(e.first_y) + ',' +
+                              std::to_string(e.last_x) + ',' + std::to_string(e.last_y) + ',' + age + ',' +
+                              std::to_string(e.positions) + ',' + number;
+        *row += time + ',' + event + ',' + std::to_string(e.object_id) + ',' + std::to_string(e.other) + ',' +
+                summary + ',' + header_.location + '\n';
+        if (doc) {
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"event\":\"" + std::string(event) + "\",\"person\":" + std::to_string(e.object_id) +
+                    ",\"other\":" + std::to_string(e.other) + ",\"first_x\":" + std::to_string(e.first_x) +
+                    ",\"first_y\":" + std::to_string(e.first_y) + ",\"x\":" + std::to_string(e.last_x) +
+                    ",\"y\":" + std::to_string(e.last_y) + ",\"age\":" + age + ",\"positions\":" +
+                    std::to_string(e.positions) + ",\"path\":" + number + ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    case LogRecord::kOccupancy: {
+        const LogRecord::Occupancy &occupancy = r.occupancy;
+        const std::string zone = occupancy.zone < 0 ? "all" : ZoneName(occupancy.zone);
+        std::string length = std::to_string(occupancy.length_s);
+        snprintf(number, sizeof(number), "%.2f", occupancy.average);
+        *row += time + ',' + length + ',' + zone + ',' + number + ',' + std::to_string(occupancy.peak) + ',' +
+                std::to_string(occupancy.unique) + ',' + header_.location + '\n';
+        if (doc) {
+            *doc += "{\"time\":";
+            AppendJsonString(time, doc);
+            *doc += ",\"bucket_sec\":" + length + ",\"zone\":";
+            AppendJsonString(zone, doc);
+            *doc += ",\"average\":" + std::string(number) + ",\"peak\":" + std::to_string(occupancy.peak) +
+                    ",\"unique\":" + std::to_string(occupancy.unique) + ",\"location\":";
+            AppendJsonString(header_.location, doc);
+            *doc += "}\n";
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void AsyncLogWriter::Run() {
+    // Documents of a kind go to the bulk index of the same kind.
+    static_assert(static_cast<int>(BulkSink::kOccupancy) == static_cast<int>(LogRecord::kOccupancy),
+                  "BulkSink::Kind must follow LogRecord::Kind");
+    const std::chrono::milliseconds kIdleWait(20);
+    const std::chrono::seconds kRotateRetry(60);
+    const size_t kKinds = LogRecord::kKindCount;
+    TrajLogEncoder encoder;
+    std::array<std::string, LogRecord::kKindCount> rows;
+    std::array<std::string, LogRecord::kKindCount> docs;
+    std::array<size_t, LogRecord::kKindCount> doc_counts;
+    doc_counts.fill(0);
+    // A failed rotation is retried after a while instead of on every batch.
+    std::array<std::chrono::steady_clock::time_point, LogRecord::kKindCount> rotate_after;
+    rotate_after.fill(std::chrono::steady_clock::time_point());
+    LogRecord r;
+
+    TraceRecorder::SetThreadName("log writer");
+    try {
+        if (binary_) encoder.Begin(header_, &rows[LogRecord::kTrajectory]);
+        for (;;) {
+            // Read the flag before draining, so nothing pushed before Close is lost.
+            bool stop = stop_;
+            size_t count = 0;
+            auto batch_start = TraceRecorder::Clock::now();
+            while (queue_.TryPop(&r)) {
+                count++;
+                if (r.kind >= kKinds) continue;
+                Format(r, &encoder, &rows[r.kind], sink_ ? &docs[r.kind] : nullptr);
+                if (sink_) doc_counts[r.kind]++;
+            }
+            if (sink_) {
+                for (size_t kind = 0; kind < kKinds; kind++) {
+                    sink_->Add(static_cast<BulkSink::Kind>(kind), docs[kind], doc_counts[kind]);
+                    docs[kind].clear();
+                    doc_counts[kind] = 0;
+                }
+            }
+            // Segments are switched between batches, so rows are never split.
+            std::array<bool, LogRecord::kKindCount> rotate;
+            auto now = std::chrono::steady_clock::now();
+            for (size_t kind = 0; kind < kKinds; kind++) {
+                rotate[kind] = !stop && logs_[kind] && now >= rotate_after[kind] && logs_[kind]->RotationDue();
+            }
+
+            // A batch is complete when the queue runs dry; close the block so
+            // the rows are readable even if the process dies before Finish.
+            std::string &traj_rows = rows[LogRecord::kTrajectory];
+            if (binary_ && count == 0) encoder.Flush(&traj_rows);
+            if (binary_ && stop) encoder.Finish(&traj_rows);
+
+            for (size_t kind = 0; kind < kKinds; kind++) {
+                if (logs_[kind] && !rows[kind].empty()) logs_[kind]->Write(rows[kind]);
+                rows[kind].clear();
+            }
+
+            for (size_t kind = 0; kind < kKinds; kind++) {
+                if (!rotate[kind]) continue;
+                // Every binary segment is a complete log with its own header
+                // and index. The index is only written if the segment is
+                // really closed, so a failed rotation leaves the log open.
+                bool restart = binary_ && kind == LogRecord::kTrajectory;
+                std::string index;
+                if (restart) {
+                    TrajLogEncoder finished = encoder;
+                    finished.Finish(&index);
+                }
+                try {
+                    compressor_.Compress(logs_[kind]->Rotate(index));
+                } catch (const std::exception &error) {
+                    // Rows keep going to the current file.
+                    std::cerr << "[ WARNING ] " << error.what() << std::endl;
+                    rotate_after[kind] = now + kRotateRetry;
+                    continue;
+                }
+                if (restart) {
+                    encoder = TrajLogEncoder();
+                    encoder.Begin(header_, &traj_rows);
+                }
+            }
+            if (count > 0) TraceRecorder::Record("write batch", batch_start, TraceRecorder::Clock::now());
+
+            if (stop) break;
+            if (count == 0) std::this_thread::sleep_for(kIdleWait);
+        }
+        for (auto &log : logs_) {
+            if (log) log->Flush();
+        }
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+}
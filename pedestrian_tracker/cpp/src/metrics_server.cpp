@@ -0,0 +1,199 @@
+#include "metrics_server.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+// Upper bounds of the latency buckets, in seconds.
+const double kBucketBounds[LatencyHistogram::kBucketsNum] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5};
+
+const int kPollTimeoutMs = 200;
+const int kSocketTimeoutSec = 2;
+
+void AppendMetric(const char *name, const char *type, const char *help,
+                  double value, std::string *out) {
+    char line[256];
+    snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n",
+             name, help, name, type, name, value);
+    *out += line;
+}
+
+bool SendAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+}  // anonymous namespace
+
+LatencyHistogram::LatencyHistogram() : sum_ns_(0) {
+    for (auto &count : counts_) count = 0;
+}
+
+void LatencyHistogram::Observe(std::chrono::steady_clock::duration latency) {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+    if (ns < 0) ns = 0;
+    double seconds = ns * 1e-9;
+    int bucket = 0;
+    while (bucket < kBucketsNum && seconds > kBucketBounds[bucket]) ++bucket;
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Render(const std::string &name, const std::string &labels,
+                              std::string *out) const {
+    char line[256];
+    uint64_t cumulative = 0;
+    for (int i = 0; i <= kBucketsNum; ++i) {
+        cumulative += counts_[i].load(std::memory_order_relaxed);
+        if (i < kBucketsNum) {
+            snprintf(line, sizeof(line), "%s_bucket{%s,le=\"%g\"} %llu\n", name.c_str(),
+                     labels.c_str(), kBucketBounds[i], static_cast<unsigned long long>(cumulative));
+        } else {
+            snprintf(line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %llu\n", name.c_str(),
+                     labels.c_str(), static_cast<unsigned long long>(cumulative));
+        }
+        *out += line;
+    }
+    snprintf(line, sizeof(line), "%s_sum{%s} %.9f\n%s_count{%s} %llu\n",
+             name.c_str(), labels.c_str(), sum_ns_.load(std::memory_order_relaxed) * 1e-9,
+             name.c_str(), labels.c_str(), static_cast<unsigned long long>(cumulative));
+    *out += line;
+}
+
+TrackerMetrics::TrackerMetrics()
+    : frames(0),
+    fps(0.0),
+    active_tracks(0),
+    reid_calls(0),
+    reid_per_sec(0.0),
+    log_queue_depth(0),
+    log_queue_high_water(0),
+    log_dropped(0),
+    bulk_pending(0) {}
+
+const char *TrackerMetrics::StageName(Stage stage) {
+    static const char *names[kStagesNum] = {
+        "capture", "detect", "track", "reid", "draw", "encode", "log"};
+    return names[stage];
+}
+
+std::string TrackerMetrics::Render() const {
+    std::string out;
+    out += "# HELP pedestrian_tracker_stage_latency_seconds Per-frame latency of a pipeline stage.\n"
+           "# TYPE pedestrian_tracker_stage_latency_seconds histogram\n";
+    for (int i = 0; i < kStagesNum; ++i) {
+        stages[i].Render("pedestrian_tracker_stage_latency_seconds",
+                         std::string("stage=\"") + StageName(static_cast<Stage>(i)) + "\"", &out);
+    }
+    AppendMetric("pedestrian_tracker_frames_total", "counter",
+                 "Processed frames.", static_cast<double>(frames.load()), &out);
+    AppendMetric("pedestrian_tracker_fps", "gauge",
+                 "Frames per second over the last second.", fps.load(), &out);
+    AppendMetric("pedestrian_tracker_active_tracks", "gauge",
+                 "Tracks visible on the last frame.", static_cast<double>(active_tracks.load()), &out);
+    AppendMetric("pedestrian_tracker_reid_calls_total", "counter",
+                 "Reid descriptor computations.", static_cast<double>(reid_calls.load()), &out);
+    AppendMetric("pedestrian_tracker_reid_calls_per_second", "gauge",
+                 "Reid descriptor computations per second over the last second.",
+                 reid_per_sec.load(), &out);
+    AppendMetric("pedestrian_tracker_log_queue_depth", "gauge",
+                 "Records waiting for the log writer.", static_cast<double>(log_queue_depth.load()), &out);
+    AppendMetric("pedestrian_tracker_log_queue_high_water", "gauge",
+                 "Max records the log queue has held.",
+                 static_cast<double>(log_queue_high_water.load()), &out);
+    AppendMetric("pedestrian_tracker_log_dropped_total", "counter",
+                 "Records dropped because the log queue was full.",
+                 static_cast<double>(log_dropped.load()), &out);
+    AppendMetric("pedestrian_tracker_bulk_pending", "gauge",
+                 "Documents waiting for the bulk endpoint.", static_cast<double>(bulk_pending.load()), &out);
+    return out;
+}
+
+MetricsServer::MetricsServer(const TrackerMetrics &metrics, int port)
+    : metrics_(metrics), listen_fd_(-1), stop_(false) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ == -1) {
+        throw std::runtime_error(std::string("Can't create metrics socket: ") + strerror(errno));
+    }
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 ||
+        listen(listen_fd_, 8) == -1) {
+        std::string error = strerror(errno);
+        close(listen_fd_);
+        throw std::runtime_error("Can't listen for metrics on port " + std::to_string(port) + ": " + error);
+    }
+    thread_ = std::thread(&MetricsServer::Run, this);
+}
+
+MetricsServer::~MetricsServer() {
+    stop_ = true;
+    thread_.join();
+    close(listen_fd_);
+}
+
+void MetricsServer::Run() {
+    while (!stop_) {
+        struct pollfd pfd = {listen_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, kPollTimeoutMs) <= 0) continue;
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd == -1) continue;
+        Serve(fd);
+        close(fd);
+    }
+}
+
+void MetricsServer::Serve(int fd) {
+    // Scrapes are served one at a time; the timeout keeps a stuck client
+    // from blocking the others for long.
+    struct timeval timeout = {kSocketTimeoutSec, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string status;
+    std::string body;
+    std::string type = "text/plain; charset=utf-8";
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+        status = "200 OK";
+        body = metrics_.Render();
+        type = "text/plain; version=0.0.4; charset=utf-8";
+    } else {
+        status = "404 Not Found";
+        body = "Not found\n";
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: " + type + "\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    SendAll(fd, response.data(), response.size());
+}
@@ -0,0 +1,94 @@
+#include "motion_model.hpp"
+
+#include <algorithm>
+
+namespace {
+// Standard deviations relative to the box height (same weights as DeepSORT).
+const float kPositionStdWeight = 1.f / 20;
+const float kVelocityStdWeight = 1.f / 160;
+
+inline float Sqr(float v) { return v * v; }
+}  // anonymous namespace
+
+void KalmanBoxFilter::Axis::Init(float value, float pos_std, float vel_std) {
+    pos = value;
+    vel = 0.f;
+    p00 = Sqr(2 * pos_std);
+    p01 = 0.f;
+    p11 = Sqr(10 * vel_std);
+}
+
+void KalmanBoxFilter::Axis::Predict(float dt, float pos_std, float vel_std) {
+    // x = F x, P = F P F^T + Q with F = [1 dt; 0 1].
+    pos += vel * dt;
+    p00 += dt * (2 * p01 + dt * p11) + Sqr(pos_std) * dt;
+    p01 += dt * p11;
+    p11 += Sqr(vel_std) * dt;
+}
+
+void KalmanBoxFilter::Axis::Correct(float value, float meas_std) {
+    float s = p00 + Sqr(meas_std);
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    float residual = value - pos;
+
+    pos += k0 * residual;
+    vel += k1 * residual;
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
+
+KalmanBoxFilter::KalmanBoxFilter() : frame_idx_(-1) {}
+
+KalmanBoxFilter::KalmanBoxFilter(const cv::Rect &rect, int frame_idx)
+    : frame_idx_(-1) {
+    Init(rect, frame_idx);
+}
+
+void KalmanBoxFilter::Init(const cv::Rect &rect, int frame_idx) {
+    float h = static_cast<float>(rect.height);
+    float pos_std = kPositionStdWeight * h;
+    float vel_std = kVelocityStdWeight * h;
+
+    axes_[kCenterX].Init(rect.x + rect.width * 0.5f, pos_std, vel_std);
+    axes_[kCenterY].Init(rect.y + rect.height * 0.5f, pos_std, vel_std);
+    axes_[kWidth].Init(static_cast<float>(rect.width), pos_std, vel_std);
+    axes_[kHeight].Init(h, pos_std, vel_std);
+    frame_idx_ = frame_idx;
+}
+
+void KalmanBoxFilter::Update(const cv::Rect &rect, int frame_idx) {
+    if (!initialized()) {
+        Init(rect, frame_idx);
+        return;
+    }
+
+    float h = std::max(axes_[kHeight].pos, 1.f);
+    float pos_std = kPositionStdWeight * h;
+    float vel_std = kVelocityStdWeight * h;
+    float dt = static_cast<float>(std::max(frame_idx - frame_idx_, 1));
+
+    const float values[kAxesNum] = {rect.x + rect.width * 0.5f,
+                                    rect.y + rect.height * 0.5f,
+                                    static_cast<float>(rect.width),
+                                    static_cast<float>(rect.height)};
+    for (int i = 0; i < kAxesNum; i++) {
+        axes_[i].Predict(dt, pos_std, vel_std);
+        axes_[i].Correct(values[i], pos_std);
+    }
+    frame_idx_ = frame_idx;
+}
+
+cv::Rect KalmanBoxFilter::Predict(size_t steps) const {
+    float dt = static_cast<float>(steps);
+    float cx = axes_[kCenterX].pos + axes_[kCenterX].vel * dt;
+    float cy = axes_[kCenterY].pos + axes_[kCenterY].vel * dt;
+    float w = std::max(axes_[kWidth].pos + axes_[kWidth].vel * dt, 1.f);
+    float h = std::max(axes_[kHeight].pos + axes_[kHeight].vel * dt, 1.f);
+
+    return cv::Rect(static_cast<int>(cx - w / 2),
+                    static_cast<int>(cy - h / 2),
+                    static_cast<int>(w),
+                    static_cast<int>(h));
+}
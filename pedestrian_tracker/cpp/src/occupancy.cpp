@@ -0,0 +1,123 @@
+#include "occupancy.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+#include "utils.hpp"
+
+namespace {
+const uint64_t kLevelLengthsMs[] = {1000, 60 * 1000, 60 * 60 * 1000};
+
+// Offset of the local time zone from UTC at the given time in ms, so that
+// buckets start at full local minutes and hours, also in time zones with
+// half hour offsets.
+int64_t LocalOffsetMs(uint64_t timestamp) {
+    time_t sec = static_cast<time_t>(timestamp / 1000);
+    struct tm local;
+    if (!localtime_r(&sec, &local)) return 0;
+    return static_cast<int64_t>(local.tm_gmtoff) * 1000;
+}
+}  // anonymous namespace
+
+OccupancyCounter::OccupancyCounter(const ZoneMap *zones)
+    : zones_(zones),
+    counts_(1 + (zones ? zones->size() : 0), 0) {
+    for (uint64_t length_ms : kLevelLengthsMs) {
+        Level level;
+        level.length_ms = length_ms;
+        level.start = 0;
+        level.open = false;
+        level.stats.resize(counts_.size(), Stats{0, 0, 0, std::unordered_set<int>()});
+        levels_.push_back(level);
+    }
+}
+
+void OccupancyCounter::Update(const PedestrianTracker &tracker, uint64_t timestamp) {
+    Advance(timestamp);
+
+    std::fill(counts_.begin(), counts_.end(), 0);
+    std::vector<Stats> &stats = levels_[0].stats;
+    for (const auto &view : tracker.ActiveTracks()) {
+        const Track &track = view.track;
+        if (track.log_id < 0 || track.lost) continue;
+        counts_[0]++;
+        stats[0].ids.insert(track.log_id);
+        if (!zones_) continue;
+        int zone = zones_->ZoneAt(GetBottomPoint(track.back().rect));
+        if (zone < 0) continue;
+        counts_[zone + 1]++;
+        stats[zone + 1].ids.insert(track.log_id);
+    }
+    for (size_t i = 0; i < stats.size(); i++) {
+        stats[i].frames++;
+        stats[i].sum += counts_[i];
+        stats[i].peak = std::max(stats[i].peak, counts_[i]);
+    }
+}
+
+std::vector<OccupancyBucket> OccupancyCounter::TakeBuckets(bool flush) {
+    if (flush) {
+        for (size_t level = 0; level < levels_.size(); level++) {
+            if (levels_[level].open) Close(level);
+            levels_[level].open = false;
+        }
+    }
+    std::vector<OccupancyBucket> buckets;
+    buckets.swap(finished_);
+    return buckets;
+}
+
+void OccupancyCounter::Advance(uint64_t timestamp) {
+    // Zone offsets are whole seconds, so only minutes and hours need it.
+    int64_t offset_ms = 0;
+    for (size_t level = 0; level < levels_.size(); level++) {
+        Level &current = levels_[level];
+        if (level == 1) offset_ms = LocalOffsetMs(timestamp);
+        int64_t length = static_cast<int64_t>(current.length_ms);
+        int64_t local = static_cast<int64_t>(timestamp) + offset_ms;
+        uint64_t start = timestamp - static_cast<uint64_t>((local % length + length) % length);
+        // Longer buckets can only end together with the shorter ones.
+        if (current.open && start == current.start) break;
+        if (current.open) Close(level);
+        current.start = start;
+        current.open = true;
+    }
+}
+
+void OccupancyCounter::Close(size_t level) {
+    Level &current = levels_[level];
+    Level *next = level + 1 < levels_.size() ? &levels_[level + 1] : nullptr;
+    for (size_t i = 0; i < current.stats.size(); i++) {
+        Stats &stats = current.stats[i];
+        if (stats.frames == 0) continue;
+        finished_.push_back(OccupancyBucket{current.start, static_cast<uint32_t>(current.length_ms / 1000),
+                                           static_cast<int>(i) - 1,
+                                           static_cast<float>(stats.sum) / stats.frames, stats.peak,
+                                           static_cast<uint32_t>(stats.ids.size())});
+        if (next) {
+            Stats &rollup = next->stats[i];
+            rollup.frames += stats.frames;
+            rollup.sum += stats.sum;
+            rollup.peak = std::max(rollup.peak, stats.peak);
+            rollup.ids.insert(stats.ids.begin(), stats.ids.end());
+        }
+        stats.frames = 0;
+        stats.sum = 0;
+        stats.peak = 0;
+        stats.ids.clear();
+    }
+}
+
+void SaveOccupancyLog(AsyncLogWriter &writer, const std::vector<OccupancyBucket> &buckets) {
+    for (const auto &bucket : buckets) {
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kOccupancy;
+        record.occupancy.zone = bucket.zone;
+        record.occupancy.length_s = bucket.length_s;
+        record.occupancy.average = bucket.average;
+        record.occupancy.peak = bucket.peak;
+        record.occupancy.unique = bucket.unique;
+        record.timestamp = bucket.start;
+        writer.Push(record);
+    }
+}
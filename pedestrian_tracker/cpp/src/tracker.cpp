@@ -11,9 +11,11 @@
 #include <utility>
 #include <limits>
 #include <algorithm>
+#include <cmath>
 
 #include "core.hpp"
 #include "tracker.hpp"
+#include "trace_recorder.hpp"
 #include "utils.hpp"
 #include <utils/kuhn_munkres.hpp>
 
@@ -23,6 +25,23 @@ cv::Point Center(const cv::Rect& rect) {
                      static_cast<int>(rect.y + rect.height * 0.5));
 }
 
+cv::Point2f CenterF(const cv::Rect& rect) {
+    return cv::Point2f(rect.x + rect.width * 0.5f, rect.y + rect.height * 0.5f);
+}
+
+// Distance from p to the segment from a to b.
+float SegmentDistance(const cv::Point2f &p, const cv::Point2f &a, const cv::Point2f &b) {
+    cv::Point2f ab = b - a;
+    cv::Point2f ap = p - a;
+    float len_sq = ab.x * ab.x + ab.y * ab.y;
+    float t = len_sq > 0 ? std::max(0.f, std::min(1.f, (ap.x * ab.x + ap.y * ab.y) / len_sq)) : 0.f;
+    cv::Point2f d = ap - ab * t;
+    return std::sqrt(d.x * d.x + d.y * d.y);
+}
+
+// Bounds the work per new box of a track that keeps walking straight.
+const size_t kMaxDroppedObjects = 64;
+
 std::vector<cv::Point> Centers(const TrackedObjects &detections) {
     std::vector<cv::Point> centers(detections.size());
     for (size_t i = 0; i < detections.size(); i++) {
@@ -55,15 +74,6 @@ DetectionLog ConvertTracksToDetectionLog(const ObjectTracks& tracks) {
     return log;
 }
 
-DetectionLogExtraEntry ConvertTracksToDetectionLogExtra(const Track &track) {
-
-    DetectionLogExtraEntry entry;
-    entry.object_id = track.objects.back().object_id;
-    entry.init_time = track.timestamp_roi;
-    entry.time_of_stay = track.time_of_stay;
-    return entry;
-}
-
 inline bool IsInRange(float val, float min, float max) {
     return min <= val && val <= max;
 }
@@ -96,10 +106,13 @@ TrackerParams::TrackerParams()
     bbox_aspect_ratios_range(0.666f, 5.0f),
     bbox_heights_range(65, 1000),
     predict(25),
+    kalman_predict(true),
     strong_affinity_thr(0.2805f),
     reid_thr(0.61f),
     drop_forgotten_tracks(true),
-    max_num_objects_in_track(300) {}
+    max_num_objects_in_track(300),
+    emit_detection_log(false),
+    simplify_tolerance(0.f) {}
 
 void ValidateParams(const TrackerParams &p) {
     PT_CHECK_GE(p.min_track_duration, static_cast<size_t>(500));
@@ -143,6 +156,9 @@ void ValidateParams(const TrackerParams &p) {
     PT_CHECK_LE(p.reid_thr, 1.0f);
 
 
+    PT_CHECK_GE(p.simplify_tolerance, 0.0f);
+    PT_CHECK_LE(p.simplify_tolerance, 100.0f);
+
     if (p.max_num_objects_in_track > 0) {
         int min_required_track_length = static_cast<int>(p.forget_delay);
         PT_CHECK_GE(p.max_num_objects_in_track, min_required_track_length);
@@ -156,7 +172,12 @@ PedestrianTracker::PedestrianTracker(const TrackerParams &params)
     distance_strong_(nullptr),
     tracks_counter_(0),
     frame_size_(0, 0),
-    prev_timestamp_(std::numeric_limits<uint64_t>::max()) {
+    frame_elem_size_(0),
+    prev_timestamp_(std::numeric_limits<uint64_t>::max()),
+    reid_calls_(0),
+    reid_time_(0),
+    log_horizon_(std::numeric_limits<int>::min()),
+    log_tracks_counter_(0) {
         ValidateParams(params);
     }
 
@@ -195,6 +216,15 @@ const PedestrianTracker::Distance &PedestrianTracker::distance_strong() const {
 // Distance strong setter.
 void PedestrianTracker::set_distance_strong(const Distance &val) { distance_strong_ = val; }
 
+// Line counter getter.
+const std::shared_ptr<LineCounter> &PedestrianTracker::line_counter() const { return line_counter_; }
+
+// Line counter setter.
+void PedestrianTracker::set_line_counter(const std::shared_ptr<LineCounter> &val) {
+    PT_CHECK(!val || params_.emit_detection_log);
+    line_counter_ = val;
+}
+
 // Returns all tracks including forgotten (lost too many frames ago).
 const std::unordered_map<size_t, Track> &
 PedestrianTracker::tracks() const {
@@ -211,10 +241,64 @@ const std::set<size_t> &PedestrianTracker::active_track_ids() const {
 DetectionLog PedestrianTracker::GetDetectionLog(const bool valid_only) const {
     return ConvertTracksToDetectionLog(all_tracks(valid_only));
 }
-DetectionLogExtraEntry PedestrianTracker::GetDetectionLogExtra(const Track &log_track) const {
-    return ConvertTracksToDetectionLogExtra(log_track);
+
+DetectionLog PedestrianTracker::TakeDetectionLog(bool flush) {
+    PT_CHECK(params_.emit_detection_log);
+    if (flush && params_.simplify_tolerance > 0) {
+        for (size_t id : active_track_ids_) {
+            AddToDetectionLog(id, true);
+        }
+    }
+    DetectionLog log;
+    auto end = flush ? pending_log_.end() : pending_log_.lower_bound(log_horizon_);
+    for (auto it = pending_log_.begin(); it != end; ++it) {
+        DetectionLogEntry entry;
+        entry.frame_idx = it->first;
+        entry.objects = std::move(it->second);
+        log.push_back(std::move(entry));
+    }
+    pending_log_.erase(pending_log_.begin(), end);
+    return log;
 }
 
+void PedestrianTracker::AddToDetectionLog(size_t track_id, bool with_tail) {
+    Track &track = tracks_.at(track_id);
+    if (track.log_id < 0) {
+        if (!IsTrackValid(track_id)) return;
+        track.log_id = log_tracks_counter_++;
+    }
+
+    // With simplification the last object may still be dropped; it is logged
+    // once the next object keeps it or the track is lost.
+    size_t end = track.size();
+    if (params_.simplify_tolerance > 0 && !with_tail) end--;
+    size_t begin = end;
+    while (begin > 0 && track[begin - 1].frame_idx > track.logged_frame) begin--;
+    for (size_t i = begin; i < end; i++) {
+        TrackedObject object = track[i];
+        object.object_id = track.log_id;
+        pending_log_[object.frame_idx].push_back(object);
+    }
+    if (end > begin) track.logged_frame = track[end - 1].frame_idx;
+}
+
+void PedestrianTracker::UpdateDetectionLog() {
+    // Objects of a track are added to the log once the track becomes valid,
+    // so frames are finished only before the first object of every active
+    // track that is not valid yet.
+    int horizon = std::numeric_limits<int>::max();
+    for (size_t id : active_track_ids_) {
+        const Track &track = tracks_.at(id);
+        if (track.log_id < 0) {
+            horizon = std::min(horizon, track.objects.front().frame_idx);
+        } else if (track.back().frame_idx > track.logged_frame) {
+            horizon = std::min(horizon, track.back().frame_idx);
+        }
+    }
+    log_horizon_ = horizon;
+}
+
+
 TrackedObjects PedestrianTracker::FilterDetections(
     const TrackedObjects &detections) const {
     TrackedObjects filtered_detections;
@@ -249,7 +333,11 @@ void PedestrianTracker::SolveAssignmentProblem(
     ComputeDissimilarityMatrix(track_ids, detections, descriptors,
                                &dissimilarity);
 
-    auto res = KuhnMunkres().Solve(dissimilarity);
+    std::vector<size_t> res;
+    {
+        TraceSpan span("kuhn_munkres");
+        res = KuhnMunkres().Solve(dissimilarity);
+    }
 
     for (size_t i = 0; i < detections.size(); i++) {
         unmatched_detections->insert(i);
@@ -287,24 +375,15 @@ const ObjectTracks PedestrianTracker::all_tracks(bool valid_only) const {
     }
     return all_objects;
 }
-const std::vector<Track> PedestrianTracker::all_valid_tracks(bool valid_only) const{
-    std::vector<Track> valid_tracks;
-    std::set<size_t> sorted_ids;
-    for (const auto &pair : tracks()) {
-        sorted_ids.emplace(pair.first);
-    }
-    for(size_t id :sorted_ids){
-        if(tracks().at(id).is_in_roi != -1){
-            valid_tracks.push_back(std::move(tracks().at(id)));
-        }
-    }
-    return valid_tracks;
-}
 cv::Rect PedestrianTracker::PredictRect(size_t id, size_t k,
                                         size_t s) const {
     const auto &track = tracks_.at(id);
     PT_CHECK(!track.empty());
 
+    if (params_.kalman_predict) {
+        return track.motion.Predict(s + 1);
+    }
+
     if (track.size() == 1) {
         return track[0].rect;
     }
@@ -379,6 +458,11 @@ bool PedestrianTracker::EraseTrackIfItWasLostTooManyFramesAgo(
 
 bool PedestrianTracker::UpdateLostTrackAndEraseIfItsNeeded(
     size_t track_id) {
+    // The last object of a lost track stays the last one until it is found
+    // again, so it can be logged now.
+    if (params_.emit_detection_log && params_.simplify_tolerance > 0 && tracks_.at(track_id).lost == 0) {
+        AddToDetectionLog(track_id, true);
+    }
     tracks_.at(track_id).lost++;
     tracks_.at(track_id).predicted_rect =
         PredictRect(track_id, params().predict, tracks_.at(track_id).lost);
@@ -406,11 +490,13 @@ void PedestrianTracker::Process(const cv::Mat &frame,
     } else {
         PT_CHECK_EQ(frame_size_, frame.size());
     }
+    frame_elem_size_ = frame.elemSize();
 
     TrackedObjects detections = FilterDetections(input_detections);
     for (auto &obj : detections) {
         obj.timestamp = timestamp;
     }
+    if (line_counter_) line_counter_->Advance(timestamp);
 
     std::vector<cv::Mat> descriptors_fast;
     ComputeFastDesciptors(frame, detections, &descriptors_fast);
@@ -480,6 +566,7 @@ void PedestrianTracker::Process(const cv::Mat &frame,
     }
 
     prev_frame_size_ = frame.size();
+    if (params_.emit_detection_log) UpdateDetectionLog();
     if (params_.drop_forgotten_tracks) DropForgottenTracks();
 
     tracks_dists_.clear();
@@ -487,29 +574,31 @@ void PedestrianTracker::Process(const cv::Mat &frame,
 }
 
 void PedestrianTracker::DropForgottenTracks() {
-    std::unordered_map<size_t, Track> new_tracks;
-    std::set<size_t> new_active_tracks;
-
-    size_t max_id = 0;
-    if (!active_track_ids_.empty())
-        max_id =
-            *std::max_element(active_track_ids_.begin(), active_track_ids_.end());
+    // Tracks are erased or moved, never copied: they hold the whole history,
+    // descriptors and crops, and this runs on every frame.
+    for (auto it = tracks_.begin(); it != tracks_.end();) {
+        if (IsTrackForgotten(it->second)) {
+            active_track_ids_.erase(it->first);
+            it = tracks_.erase(it);
+        } else {
+            ++it;
+        }
+    }
 
     const size_t kMaxTrackID = 10000;
-    bool reassign_id = max_id > kMaxTrackID;
+    if (active_track_ids_.empty() || *active_track_ids_.rbegin() <= kMaxTrackID) return;
 
+    std::unordered_map<size_t, Track> new_tracks;
+    std::set<size_t> new_active_tracks;
     size_t counter = 0;
-    for (const auto &pair : tracks_) {
-        if (!IsTrackForgotten(pair.first)) {
-            new_tracks.emplace(reassign_id ? counter : pair.first, pair.second);
-            new_active_tracks.emplace(reassign_id ? counter : pair.first);
-            counter++;
-        }
+    for (auto &pair : tracks_) {
+        new_tracks.emplace(counter, std::move(pair.second));
+        new_active_tracks.emplace(counter);
+        counter++;
     }
     tracks_.swap(new_tracks);
     active_track_ids_.swap(new_active_tracks);
-
-    tracks_counter_ = reassign_id ? counter : tracks_counter_;
+    tracks_counter_ = counter;
 }
 
 float PedestrianTracker::ShapeAffinity(float weight, const cv::Rect &trk,
@@ -587,7 +676,12 @@ std::vector<float> PedestrianTracker::ComputeDistances(
         det_to_batch_ids[det_id] = descriptors.size() - 1;
     }
 
+    auto reid_start = std::chrono::steady_clock::now();
     descriptor_strong_->Compute(images, &descriptors);
+    auto reid_end = std::chrono::steady_clock::now();
+    reid_time_ += reid_end - reid_start;
+    TraceRecorder::Record("reid", reid_start, reid_end);
+    reid_calls_ += images.size();
 
     std::vector<cv::Mat> descriptors1;
     std::vector<cv::Mat> descriptors2;
@@ -598,6 +692,7 @@ std::vector<float> PedestrianTracker::ComputeDistances(
         if (tracks_.at(track_id).descriptor_strong.empty()) {
             tracks_.at(track_id).descriptor_strong =
                 descriptors[track_to_batch_ids[track_id]].clone();
+            tracks_.at(track_id).last_image.release();
         }
         (*det_id_to_descriptor)[det_id] = descriptors[det_to_batch_ids[det_id]];
 
@@ -691,10 +786,11 @@ void PedestrianTracker::AddNewTrack(const cv::Mat &frame,
                                     const cv::Mat &descriptor_strong) {
     auto detection_with_id = detection;
     detection_with_id.object_id = tracks_counter_;
-    tracks_.emplace(std::pair<size_t, Track>(
+    auto it = tracks_.emplace(std::pair<size_t, Track>(
             tracks_counter_,
-            Track({detection_with_id}, frame(detection.rect).clone(),
-                  descriptor_fast.clone(), descriptor_strong.clone(),-1,0,0)));
+            Track({detection_with_id}, cv::Mat(),
+                  descriptor_fast.clone(), descriptor_strong.clone()))).first;
+    UpdateLastImage(frame, detection.rect, &it->second);
 
     for (size_t id : active_track_ids_) {
         tracks_dists_.emplace(std::pair<size_t, size_t>(id, tracks_counter_),
@@ -705,6 +801,33 @@ void PedestrianTracker::AddNewTrack(const cv::Mat &frame,
     tracks_counter_++;
 }
 
+void PedestrianTracker::SimplifyTail(Track *track, const cv::Rect &next) const {
+    // Online Douglas-Peucker (opening window): the last object is dropped if
+    // its center and the centers of all objects dropped since the last kept
+    // one are within the tolerance of the segment from the last kept object
+    // to the new one. Every dropped center is thus within the tolerance of
+    // the polyline through the kept objects.
+    if (track->size() < 2 || track->back().frame_idx <= track->logged_frame ||
+        track->dropped.size() >= kMaxDroppedObjects) {
+        track->dropped.clear();
+        return;
+    }
+    const float tolerance = params_.simplify_tolerance;
+    cv::Point2f from = CenterF((*track)[track->size() - 2].rect);
+    cv::Point2f to = CenterF(next);
+    cv::Point2f tail = CenterF(track->back().rect);
+    bool keep = SegmentDistance(tail, from, to) > tolerance;
+    for (size_t i = 0; i < track->dropped.size() && !keep; i++) {
+        keep = SegmentDistance(track->dropped[i], from, to) > tolerance;
+    }
+    if (keep) {
+        track->dropped.clear();
+        return;
+    }
+    track->dropped.push_back(tail);
+    track->objects.pop_back();
+}
+
 void PedestrianTracker::AppendToTrack(const cv::Mat &frame,
                                       size_t track_id,
                                       const TrackedObject &detection,
@@ -716,10 +839,14 @@ void PedestrianTracker::AppendToTrack(const cv::Mat &frame,
     detection_with_id.object_id = track_id;
 
     auto &cur_track = tracks_.at(track_id);
+    const cv::Point2f step_from = GetBottomPoint(cur_track.back().rect);
+    if (params_.simplify_tolerance > 0) SimplifyTail(&cur_track, detection.rect);
     cur_track.objects.emplace_back(detection_with_id);
-    cur_track.predicted_rect = detection.rect;
+    cur_track.motion.Update(detection.rect, detection.frame_idx);
+    cur_track.predicted_rect = params_.kalman_predict
+                               ? cur_track.motion.Predict(1)
+                               : detection.rect;
     cur_track.lost = 0;
-    cur_track.last_image = frame(detection.rect).clone();
     cur_track.descriptor_fast = descriptor_fast.clone();
     cur_track.length++;
 
@@ -729,6 +856,7 @@ void PedestrianTracker::AppendToTrack(const cv::Mat &frame,
         cur_track.descriptor_strong =
             0.5 * (descriptor_strong + cur_track.descriptor_strong);
     }
+    UpdateLastImage(frame, detection.rect, &cur_track);
 
 
     if (params_.max_num_objects_in_track > 0) {
@@ -737,6 +865,42 @@ void PedestrianTracker::AppendToTrack(const cv::Mat &frame,
             cur_track.objects.erase(cur_track.objects.begin());
         }
     }
+
+    if (params_.emit_detection_log) AddToDetectionLog(track_id);
+    // Only the latest step of the track is tested against the lines.
+    if (line_counter_) {
+        CountLineStep(&cur_track, TrackStep{step_from, GetBottomPoint(detection.rect), detection.timestamp});
+    }
+}
+
+void PedestrianTracker::CountLineStep(Track *track, const TrackStep &step) {
+    // Steps of a track that is not valid yet are held back, so that tracks
+    // dropped as too short are not counted and every crossing has the ID of
+    // the track. They are counted in the bucket the track becomes valid in.
+    track->line_steps.push_back(step);
+    if (track->log_id < 0) return;
+    for (const auto &held : track->line_steps) {
+        line_counter_->Step(held.from, held.to, track->log_id, held.timestamp);
+    }
+    track->line_steps.clear();
+}
+
+void PedestrianTracker::UpdateLastImage(const cv::Mat &frame,
+                                        const cv::Rect &rect,
+                                        Track *track) const {
+    PT_CHECK(track);
+    // The crop is only read to compute the strong descriptor of the track.
+    if (!descriptor_strong_ || !track->descriptor_strong.empty()) {
+        track->last_image.release();
+        return;
+    }
+
+    cv::Size input_size = descriptor_strong_->input_size();
+    if (input_size.area() > 0) {
+        cv::resize(frame(rect), track->last_image, input_size);
+    } else {
+        track->last_image = frame(rect).clone();
+    }
 }
 
 float PedestrianTracker::AffinityFast(const cv::Mat &descriptor1,
@@ -793,75 +957,54 @@ bool PedestrianTracker::IsTrackForgotten(const Track &track) const {
 std::unordered_map<size_t, std::vector<cv::Point>>
 PedestrianTracker::GetActiveTracks() const {
     std::unordered_map<size_t, std::vector<cv::Point>> active_tracks;
-    for (size_t idx : active_track_ids()) {
-        auto track = tracks().at(idx);
-        if (IsTrackValid(idx) && !IsTrackForgotten(idx)) {
-            active_tracks.emplace(idx, Centers(track.objects));
-        }
+    for (const auto &view : ActiveTracks()) {
+        active_tracks.emplace(view.id, Centers(view.track.objects));
     }
     return active_tracks;
 }
 
+PedestrianTracker::ActiveTracksView PedestrianTracker::ActiveTracks() const {
+    return ActiveTracksView(*this);
+}
 
 TrackedObjects PedestrianTracker::TrackedDetections()  {
     TrackedObjects detections;
-    for (size_t idx : active_track_ids()) {
-        auto track = tracks().at(idx);
-        if (IsTrackValid(idx) && !track.lost) {
-            detections.emplace_back(track.objects.back());
+    for (const auto &view : ActiveTracks()) {
+        if (!view.track.lost) {
+            detections.emplace_back(view.track.back());
         }
     }
     return detections;
 }
-//----//
-std::vector<Track> PedestrianTracker::CheckInRoi(const std::vector<cv::Point2f> &roi){
-    std::vector<Track> temp_track;
-    double check;
-    for (size_t idx : active_track_ids()) {
-        auto track = tracks().at(idx);
-        if (IsTrackValid(idx) && !track.lost) {
-            check = cv::pointPolygonTest(roi,GetBottomPoint(track.objects.back().rect),false);
-            if((check == 1 || check == 0) && tracks().at(idx).is_in_roi != 0){
-                tracks_.at(idx).timestamp_roi = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-                tracks_.at(idx).is_in_roi = 0;
-            }
-            if (check == -1 && tracks().at(idx).is_in_roi == 0){
-                uint64_t cur_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-                tracks_.at(idx).time_of_stay += cur_time - tracks().at(idx).timestamp_roi;
-                //std::cout << "person-" << tracks().at(idx).objects.back().object_id << "stayed in the box for " << (float) tracks().at(idx).time_of_stay  / 1000<< "s" << std::endl;
-                tracks_.at(idx).is_in_roi = 1;
-                temp_track.push_back(std::move(tracks().at(idx)));
-            } 
-        }
-    }
-    return temp_track;
-}
-//----//
 cv::Mat PedestrianTracker::DrawActiveTracks(const cv::Mat &frame) {
     cv::Mat out_frame = frame.clone();
+    DrawActiveTracks(&out_frame);
+    return out_frame;
+}
+
+void PedestrianTracker::DrawActiveTracks(cv::Mat *frame) {
+    PT_CHECK(frame);
+    PT_CHECK_EQ(frame->type(), CV_8UC3);
 
     if (colors_.empty()) {
         int num_colors = 100;
         colors_ = GenRandomColors(num_colors);
     }
 
-    auto active_tracks = GetActiveTracks();
-    for (auto active_track : active_tracks) {
-        size_t idx = active_track.first;
-        auto centers = active_track.second;
-        DrawPolyline(centers, colors_[idx % colors_.size()], &out_frame);
-        std::stringstream ss;
-        ss << idx;
-        cv::putText(out_frame, ss.str(), centers.back(), cv::FONT_HERSHEY_SCRIPT_COMPLEX, 2.0,
-                    colors_[idx % colors_.size()], 3);
-        auto track = tracks().at(idx);
+    for (const auto &view : ActiveTracks()) {
+        const cv::Scalar &color = colors_[view.id % colors_.size()];
+        const Track &track = view.track;
+        for (size_t i = 1; i < track.size(); i++) {
+            cv::line(*frame, view.center(i - 1), view.center(i), color, 5);
+        }
+        cv::Point last_center = view.center(track.size() - 1);
+        cv::putText(*frame, std::to_string(view.id), last_center, cv::FONT_HERSHEY_SCRIPT_COMPLEX, 2.0,
+                    color, 3);
         if (track.lost) {
-            cv::line(out_frame, active_track.second.back(),
+            cv::line(*frame, last_center,
                      Center(track.predicted_rect), cv::Scalar(0, 0, 0), 4);
         }
     }
-
-    return out_frame;
 }
 
 void PedestrianTracker::PrintReidPerformanceCounts(std::string fullDeviceName) const {
@@ -869,3 +1012,21 @@ void PedestrianTracker::PrintReidPerformanceCounts(std::string fullDeviceName) c
         descriptor_strong_->PrintPerformanceCounts(fullDeviceName);
     }
 }
+
+size_t PedestrianTracker::reid_calls() const {
+    return reid_calls_;
+}
+
+std::chrono::steady_clock::duration PedestrianTracker::reid_time() const {
+    return reid_time_;
+}
+
+CropMemoryStats PedestrianTracker::GetCropMemoryStats() const {
+    CropMemoryStats stats;
+    for (const auto &pair : tracks_) {
+        const Track &track = pair.second;
+        stats.held_bytes += track.last_image.total() * track.last_image.elemSize();
+        stats.full_bytes += static_cast<size_t>(track.back().rect.area()) * frame_elem_size_;
+    }
+    return stats;
+}
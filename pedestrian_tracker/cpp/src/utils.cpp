@@ -63,38 +63,6 @@ namespace
         }
     }
 } // anonymous namespace
-namespace
-{
-    template <typename StreamType>
-    void SaveDetectionExtraLogToStream(StreamType &stream,
-                                       const DetectionLogExtra &log)
-    {
-        struct tm *timestamp;
-        time_t tTime;
-        std::chrono::system_clock::time_point tPoint;
-        std::string timeStr;
-
-        for (const auto &entry : log)
-        {
-            if (entry.second.time_of_stay == 0)
-            {
-                continue;
-            }
-            else
-            {
-                tPoint = std::chrono::system_clock::from_time_t(0) + std::chrono::milliseconds(entry.second.init_time);
-                tTime = std::chrono::system_clock::to_time_t(tPoint);
-                timestamp = localtime(&tTime);
-                timeStr = asctime(timestamp);
-                timeStr.pop_back();
-                stream << entry.second.object_id << ',' << timeStr << ','
-                       << (float)entry.second.time_of_stay / 1000 << ','
-                       << entry.second.location;
-                stream << '\n';
-            }
-        }
-    }
-} // anonymous namespace
 
 void DrawPolyline(const std::vector<cv::Point> &polyline,
                   const cv::Scalar &color, cv::Mat *image, int lwd)
@@ -189,7 +157,7 @@ void SetPoints(MouseParams *mp, unsigned int point_num, std::string name)
 }
 
 //Read Camera and ROI configuration files
-std::vector<cv::Point2f> ReadConfig(const std::string &path, const size_t &line_num)
+std::vector<cv::Point2f> ReadConfigPoints(const std::string &path)
 {
     std::ifstream config_file(path);
     std::string line;
@@ -222,6 +190,12 @@ std::vector<cv::Point2f> ReadConfig(const std::string &path, const size_t &line_
             throw std::runtime_error("config file is in a wrong format (" + path + ")");
         }
     }
+    return points;
+}
+
+std::vector<cv::Point2f> ReadConfig(const std::string &path, const size_t &line_num)
+{
+    std::vector<cv::Point2f> points = ReadConfigPoints(path);
     if (points.size() != line_num)
     {
         throw std::runtime_error("config file should have total size of " + std::to_string(line_num) + "(" + path + ")");
@@ -306,9 +280,17 @@ void ReConfig(const std::string &input, MouseParams *mp)
         SetPoints(mp, num_points, window_name);
         WriteConfig(config_log_paths::PATHTOROICONFIG, mp->mouse_input);
     }
+    else if (input == "line")
+    {
+        std::string window_name = "Line-Config";
+        unsigned int num_points = 2; //one counting line, add more by editing the file
+        ReConfigWindow(window_name, mp);
+        SetPoints(mp, num_points, window_name);
+        WriteConfig(config_log_paths::PATHTOLINECONFIG, mp->mouse_input);
+    }
     else
     {
-        throw std::runtime_error("invalid option (valid option: 'cam' or 'roi')");
+        throw std::runtime_error("invalid option (valid option: 'cam', 'roi' or 'line')");
     }
 }
 bool IsPathExist(const std::string &path){
@@ -334,38 +316,36 @@ void SaveDetectionLogToTrajFile(const std::string& path,
     }
     
 }
+void SaveDetectionLogToTrajFile(AsyncLogWriter& writer,
+                                const DetectionLog& log) {
+    LogRecord record = LogRecord();
+    record.kind = LogRecord::kTrajectory;
+    LogRecord::Trajectory &row = record.trajectory;
+    std::vector<const TrackedObject*> objects;
+    for (const auto &entry : log) {
+        objects.clear();
+        for (const auto &object : entry.objects)
+            objects.push_back(&object);
+        std::sort(objects.begin(), objects.end(),
+                  [](const TrackedObject *a, const TrackedObject *b)
+                  { return a->object_id < b->object_id; });
+        for (const TrackedObject *object : objects) {
+            row.frame_idx = entry.frame_idx;
+            row.object_id = object->object_id;
+            row.x = object->rect.x;
+            row.y = object->rect.y;
+            row.width = object->rect.width;
+            row.height = object->rect.height;
+            row.confidence = static_cast<float>(object->confidence);
+            record.timestamp = object->timestamp;
+            writer.Push(record);
+        }
+    }
+}
 std::string GetLogPath(const std::string &file_name,const std::string &extension){
     std::vector<std::string> temp = SplitString(file_name,'.');  
     return config_log_paths::PATHTOLOG + temp[0] + extension;
 }
-//Save the detection log to a file excluding location
-void SaveDetectionLogToTrajFile(const std::string &path,
-                                const DetectionLogExtra &log)
-{
-    std::ofstream file;
-    if(IsPathExist(config_log_paths::PATHTOLOG))
-    {
-        std::string temp = GetLogPath(path,"-roi.csv");
-        file.open(GetLogPath(path,"-roi.csv").c_str(), std::ios_base::app);
-        if(file.is_open()){
-            SaveDetectionExtraLogToStream(file, log);
-        }else{
-            throw std::runtime_error(path + " is not a valid input(file name only)");
-        }
-       
-    }else{
-        if(CreateDir(config_log_paths::PATHTOLOG.c_str())){
-            std::string temp = GetLogPath(path,"-roi.csv");
-            file.open(GetLogPath(path,"-roi.csv").c_str(), std::ios_base::app);
-            if(file.is_open()){
-                SaveDetectionExtraLogToStream(file, log);
-            }else{
-                std::runtime_error(path + "is not a valid input(file name only)");
-            }
-        }
-    }
-    
-}
 
 void PrintDetectionLog(const DetectionLog &log, const std::string &location, const std::string &uuid)
 {
@@ -399,6 +379,27 @@ bool CreateDir(const std::string &path){
     }
     return true;
 }
+MoveDirection GetMoveDirection(const cv::Point &from, const cv::Point &to)
+{
+    //larger of the two distances is the direction that the user is moving
+    if (abs(from.x - to.x) > abs(from.y - to.y))
+        return from.x < to.x ? MoveDirection::kLeft : MoveDirection::kRight;
+    //if Y is going down then the user is walking up
+    return from.y > to.y ? MoveDirection::kForward : MoveDirection::kBackward;
+}
+
+const char *MoveDirectionName(MoveDirection direction)
+{
+    switch (direction)
+    {
+    case MoveDirection::kLeft: return "LEFT";
+    case MoveDirection::kRight: return "RIGHT";
+    case MoveDirection::kForward: return "FORWARD";
+    case MoveDirection::kBackward: return "BACKWARD";
+    }
+    return "";
+}
+
 std::map<int, std::string> LocateDirection(std::vector<LogInformation> &logList)
 {
     //if Y is going down then the user is walking up
@@ -420,54 +421,45 @@ std::map<int, std::string> LocateDirection(std::vector<LogInformation> &logList)
         }
         else
         {
-            //larger of the two numbers will be the direction that the user is moving
-            int maxXValue = abs(xMap[it->uniqueID] - it->x_Location);
-            int maxYValue = abs(yMap[it->uniqueID] - it->y_Location);
-
-            if (maxXValue > maxYValue)
-            {
-                if (xMap[it->uniqueID] < it->x_Location)
-                    direction[it->uniqueID] = "LEFT";
-
-                else
-                    direction[it->uniqueID] = "RIGHT";
-            }
-            else
-            {
-                if (yMap[it->uniqueID] > it->y_Location)
-                    direction[it->uniqueID] = "FORWARD";
-                else
-                    direction[it->uniqueID] = "BACKWARD";
-            }
+            direction[it->uniqueID] = MoveDirectionName(GetMoveDirection(
+                cv::Point(xMap[it->uniqueID], yMap[it->uniqueID]),
+                cv::Point(it->x_Location, it->y_Location)));
         }
     }
     return direction;
 }
 
 //
-void WriteDirectionLog(const std::string &path)
+void WriteDirectionLog(const std::string &path, bool binary)
 {
 
     //Define relivant private parameters
-    std::string file_name = GetLogPath(path,"-peopletracker.csv");
+    std::string file_name = GetLogPath(path, binary ? "-peopletracker.bin" : "-peopletracker.csv");
     std::cout << "FileName is: " << file_name << std::endl;
-    std::ifstream logFile(file_name);
     std::vector<LogInformation> logList;
     std::map<int, std::string> dateMap;
 
     //std::string newFileName = file_name.insert(file_name.length() - 4, "-direction");
     std::string newFileName = GetLogPath(path,"-directions.csv");
-    std::string line;
 
     std::cout << newFileName << std::endl;
 
-    while (std::getline(logFile, line))
+    if (binary)
+    {
+        TrajLogReader reader(file_name);
+        std::vector<TrajRow> rows;
+        reader.ReadAll(&rows);
+        for (const auto &row : rows)
+            logList.push_back(LogInformation(row, reader.header().location));
+    }
+    else
     {
-        std::stringstream iss(line);
-        LogInformation log(iss);
-        logList.push_back(log);
-        //std::cout << iss.str() << std::endl;
-        // process pair (a,b)
+        MappedFile logFile(file_name);
+        CsvReader reader(logFile.data(), logFile.size());
+        while (reader.Next())
+        {
+            logList.push_back(LogInformation(reader));
+        }
     }
 
     //Save the date and time of the person exiting the frame
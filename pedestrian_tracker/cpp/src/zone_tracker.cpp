@@ -0,0 +1,211 @@
+#include "zone_tracker.hpp"
+
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+#include "event_stream.hpp"
+#include "utils.hpp"
+
+ZoneMap::ZoneMap(const std::vector<Zone> &zones, const cv::Size &frame_size)
+    : zones_(zones),
+    labels_(frame_size, CV_16U, cv::Scalar(0)) {
+    if (zones_.size() >= std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error("Too many zones: " + std::to_string(zones_.size()));
+    }
+    for (size_t i = 0; i < zones_.size(); i++) {
+        std::vector<std::vector<cv::Point>> polygon(1);
+        for (const auto &point : zones_[i].polygon) {
+            polygon[0].push_back(cv::Point(cvRound(point.x), cvRound(point.y)));
+        }
+        cv::fillPoly(labels_, polygon, cv::Scalar(static_cast<double>(i + 1)));
+    }
+}
+
+void ZoneMap::Draw(cv::Mat *frame) const {
+    const cv::Scalar color(70, 70, 70);
+    for (const auto &zone : zones_) {
+        DrawRoi(zone.polygon, color, frame, 2);
+        cv::putText(*frame, zone.name, zone.polygon[0], cv::FONT_HERSHEY_SIMPLEX, 0.6, color, 2);
+    }
+}
+
+FlowMatrix::FlowMatrix(size_t zones, uint64_t bucket_ms)
+    : zones_(zones),
+    bucket_ms_(bucket_ms > 0 ? bucket_ms : 1),
+    bucket_start_(0),
+    bucket_open_(false),
+    counts_(zones * zones, 0) {}
+
+void FlowMatrix::Advance(uint64_t timestamp) {
+    uint64_t bucket_start = timestamp - timestamp % bucket_ms_;
+    if (bucket_open_ && bucket_start == bucket_start_) return;
+    if (bucket_open_) CloseBucket();
+    bucket_start_ = bucket_start;
+    bucket_open_ = true;
+}
+
+void FlowMatrix::Add(int origin, int destination) {
+    if (origin < 0 || destination < 0) return;
+    counts_[static_cast<size_t>(origin) * zones_ + static_cast<size_t>(destination)]++;
+}
+
+std::vector<FlowCount> FlowMatrix::TakeCounts(bool flush) {
+    if (flush && bucket_open_) {
+        CloseBucket();
+        bucket_open_ = false;
+    }
+    std::vector<FlowCount> counts;
+    counts.swap(finished_);
+    return counts;
+}
+
+void FlowMatrix::CloseBucket() {
+    for (size_t i = 0; i < counts_.size(); i++) {
+        if (counts_[i] == 0) continue;
+        finished_.push_back(FlowCount{bucket_start_, static_cast<int>(i / zones_),
+                                      static_cast<int>(i % zones_), counts_[i]});
+        counts_[i] = 0;
+    }
+}
+
+ZoneTracker::ZoneTracker(const ZoneMap &zones, FlowMatrix *flows)
+    : zones_(zones), flows_(flows), stream_(nullptr), updates_(0) {}
+
+void ZoneTracker::Update(const PedestrianTracker &tracker) {
+    ++updates_;
+    for (const auto &view : tracker.ActiveTracks()) {
+        const Track &track = view.track;
+        if (track.log_id < 0) continue;
+        auto it = tracks_.find(track.log_id);
+        if (it == tracks_.end()) {
+            it = tracks_.emplace(track.log_id, TrackState{-1, 0, 0, 0, -1, -1}).first;
+        }
+        TrackState &state = it->second;
+        state.seen = updates_;
+        if (track.lost) continue;
+
+        const TrackedObject &object = track.back();
+        int zone = zones_.ZoneAt(GetBottomPoint(object.rect));
+        if (zone != state.zone) {
+            Leave(track.log_id, &state, object.timestamp);
+            state.zone = zone;
+            state.enter_time = object.timestamp;
+            if (stream_ && zone >= 0) stream_->Add(TrackEvent::kZoneEnter, track.log_id, zone, object.timestamp);
+            if (zone >= 0) {
+                if (state.origin < 0) state.origin = zone;
+                state.destination = zone;
+            }
+        }
+        state.last_time = object.timestamp;
+    }
+
+    for (auto it = tracks_.begin(); it != tracks_.end();) {
+        if (it->second.seen != updates_) {
+            End(it->first, &it->second);
+            it = tracks_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ZoneTracker::Finish() {
+    for (auto &pair : tracks_) {
+        End(pair.first, &pair.second);
+    }
+    tracks_.clear();
+}
+
+std::vector<ZoneEvent> ZoneTracker::TakeEvents() {
+    std::vector<ZoneEvent> events;
+    events.swap(events_);
+    return events;
+}
+
+void ZoneTracker::Leave(int id, TrackState *state, uint64_t time) {
+    if (state->zone < 0) return;
+    events_.push_back(ZoneEvent{id, state->zone, state->enter_time, time});
+    if (stream_) stream_->Add(TrackEvent::kZoneExit, id, state->zone, time);
+    state->zone = -1;
+}
+
+void ZoneTracker::End(int id, TrackState *state) {
+    Leave(id, state, state->last_time);
+    if (flows_) flows_->Add(state->origin, state->destination);
+}
+
+std::vector<Zone> ReadZoneConfig(const std::string &path) {
+    std::ifstream config_file(path);
+    if (!config_file.is_open()) {
+        throw std::runtime_error("Can't open config file (" + path + "). Please ensure the folder/file exists");
+    }
+    std::vector<Zone> zones;
+    std::string line;
+    while (std::getline(config_file, line)) {
+        std::istringstream iss(line);
+        std::string first, second;
+        if (!(iss >> first)) continue;
+        if (!(iss >> second)) {
+            zones.push_back(Zone{first, std::vector<cv::Point2f>()});
+            continue;
+        }
+        if (zones.empty()) {
+            throw std::runtime_error("zone config file should start with a zone name (" + path + ")");
+        }
+        try {
+            zones.back().polygon.push_back(cv::Point2f(std::stof(first), std::stof(second)));
+        } catch (const std::invalid_argument &) {
+            throw std::runtime_error("zone config file is in a wrong format (" + path + ")");
+        }
+    }
+    if (zones.empty()) {
+        throw std::runtime_error("config file is empty (" + path + ")");
+    }
+    for (const auto &zone : zones) {
+        if (zone.polygon.size() < 3) {
+            throw std::runtime_error("zone " + zone.name + " should have at least 3 points (" + path + ")");
+        }
+    }
+    return zones;
+}
+
+void SaveZoneLog(AsyncLogWriter &writer, const std::vector<ZoneEvent> &events) {
+    for (const auto &event : events) {
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kZone;
+        record.zone.object_id = event.object_id;
+        record.zone.zone = event.zone;
+        record.zone.stay_ms = static_cast<int32_t>(event.exit_time - event.enter_time);
+        record.timestamp = event.enter_time;
+        writer.Push(record);
+    }
+}
+
+void SaveFlowLog(AsyncLogWriter &writer, const std::vector<FlowCount> &counts) {
+    for (const auto &count : counts) {
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kFlow;
+        record.flow.origin = count.origin;
+        record.flow.destination = count.destination;
+        record.flow.count = count.count;
+        record.timestamp = count.bucket_start;
+        writer.Push(record);
+    }
+}
+
+void SaveRoiLog(AsyncLogWriter &writer, const std::vector<ZoneEvent> &events) {
+    for (const auto &event : events) {
+        // A track seen in the ROI on one frame only has no time of stay.
+        if (event.exit_time == event.enter_time) continue;
+        LogRecord record = LogRecord();
+        record.kind = LogRecord::kRoi;
+        record.roi.object_id = event.object_id;
+        record.roi.stay_ms = static_cast<int32_t>(event.exit_time - event.enter_time);
+        record.timestamp = event.enter_time;
+        writer.Push(record);
+    }
+}
@@ -0,0 +1,56 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <utils/traj_log.hpp>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || 3 < argc) {
+        std::cerr << "Invalid number of arguments!" << std::endl;
+        std::cout << "Usage:" << std::endl;
+        std::cout << "  " << argv[0] << " log-peopletracker.bin [csv|ndjson] > output" << std::endl;
+        std::cout << std::endl;
+        std::cout << "  Converts a binary trajectory log written by pedestrian_tracker -log_binary." << std::endl;
+        std::cout << "  csv (default) produces the same rows as the -peopletracker.csv log." << std::endl;
+        std::cout << "  ndjson produces one JSON object per row with the field names used by" << std::endl;
+        std::cout << "  the Logstash pipeline (frame, time, person, person_x, person_y," << std::endl;
+        std::cout << "  person_width, person_height, confidence_level, location, uuid, vid)." << std::endl;
+        std::cout << "  uuid and vid are numbers, as the pipeline converts them to float." << std::endl;
+        return 1;
+    }
+
+    std::string format = argc == 3 ? argv[2] : "csv";
+    if (format != "csv" && format != "ndjson") {
+        std::cerr << "Unknown output format " << format << std::endl;
+        return 1;
+    }
+
+    try {
+        TrajLogReader reader(argv[1]);
+        std::vector<TrajRow> rows;
+        std::string out;
+        for (size_t i = 0; i < reader.blocks().size(); i++) {
+            reader.ReadBlock(i, &rows);
+            out.clear();
+            for (const auto &row : rows) {
+                if (format == "csv") {
+                    AppendTrajRowCsv(reader.header(), row, &out);
+                } else {
+                    AppendTrajRowJson(reader.header(), row, &out);
+                }
+            }
+            fwrite(out.data(), 1, out.size(), stdout);
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << "[ ERROR ] " << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
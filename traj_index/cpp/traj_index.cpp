@@ -0,0 +1,614 @@
+// Copyright (C) 2018-2019 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <utils/csv_reader.hpp>
+#include <utils/traj_log.hpp>
+
+namespace {
+const char kIndexMagic[8] = {'P', 'T', 'I', 'D', 'X', '0', '0', '1'};
+const char kIndexSuffix[] = ".ptidx";
+const uint32_t kMaxGridCells = 1024;  // Per axis; points beyond land in the last cell.
+
+///
+/// \brief Row of an index file. Rows are stored as an array of these in
+/// host byte order, so they can be used in place from the mapped file.
+///
+struct IndexRow {
+    uint64_t timestamp;
+    int32_t frame_idx;
+    int32_t object_id;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float confidence;
+    uint32_t source;  ///< Index into the (location, uuid) table.
+};
+
+///
+/// \brief All rows of one track (object ID of one run) in a file.
+///
+struct TrackEntry {
+    int32_t object_id;
+    uint32_t source;
+    uint64_t first_time;
+    uint64_t last_time;
+    uint64_t first;  ///< First position in the track row list.
+    uint64_t count;
+};
+
+///
+/// \brief Index file header.
+///
+/// The file holds, in this order: the header, the rows clustered by grid
+/// cell of their bottom point and sorted by time within a cell, the start of
+/// every cell in the rows (cols * rows + 1 entries), the tracks sorted by
+/// object ID and source, the row numbers of every track in time order, and
+/// the (location, uuid) strings.
+///
+struct IndexHeader {
+    char magic[8];
+    uint32_t cell_size;  ///< Grid cell size in pixels.
+    uint32_t cols;
+    uint32_t rows;
+    uint32_t source_count;
+    uint64_t row_count;
+    uint64_t track_count;
+    uint64_t first_time;
+    uint64_t last_time;
+    uint64_t cells_offset;
+    uint64_t tracks_offset;
+    uint64_t track_rows_offset;
+    uint64_t sources_offset;
+};
+
+typedef std::pair<std::string, std::string> Source;  // location, uuid
+
+void PrintUsage(const char *name) {
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << name << " build INDEX_DIR [-cell PIXELS] log-peopletracker.csv|.bin..." << std::endl;
+    std::cout << "  " << name << " query INDEX_DIR [-box X0 Y0 X1 Y1] [-from TIME] [-to TIME]" << std::endl;
+    std::cout << "        [-id PERSON [-uuid UUID]] [csv|ndjson|count] > output" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  build compacts trajectory log segments into one index file per day" << std::endl;
+    std::cout << "  (INDEX_DIR/YYYY-MM-DD.ptidx, local time). Segments added to an existing" << std::endl;
+    std::cout << "  day are merged into it; rows already in the index are skipped." << std::endl;
+    std::cout << "  The default grid cell size is 32 pixels." << std::endl;
+    std::cout << std::endl;
+    std::cout << "  query prints the rows whose bottom point (x + width/2, y + height) is in" << std::endl;
+    std::cout << "  the box and whose time is in [from, to), in time order, in the format of" << std::endl;
+    std::cout << "  traj_convert. TIME is \"YYYY-MM-DD HH:MM:SS\" (local) or ms since epoch." << std::endl;
+    std::cout << "  -id restricts the rows to one person ID, -uuid to one run." << std::endl;
+}
+
+// Mapped index file with its sections checked against the file size.
+class IndexFile {
+public:
+    explicit IndexFile(const std::string &path) : file_(path) {
+        if (file_.size() < sizeof(IndexHeader)) throw std::runtime_error("Not an index file: " + path);
+        header_ = reinterpret_cast<const IndexHeader *>(file_.data());
+        if (memcmp(header_->magic, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+            throw std::runtime_error("Not an index file: " + path);
+        }
+        uint64_t cells = static_cast<uint64_t>(header_->cols) * header_->rows;
+        rows_ = Section<IndexRow>(sizeof(IndexHeader), header_->row_count, path);
+        cells_ = Section<uint64_t>(header_->cells_offset, cells + 1, path);
+        tracks_ = Section<TrackEntry>(header_->tracks_offset, header_->track_count, path);
+        track_rows_ = Section<uint32_t>(header_->track_rows_offset, header_->row_count, path);
+
+        const char *p = Section<char>(header_->sources_offset, 0, path);
+        const char *end = file_.data() + file_.size();
+        for (uint32_t i = 0; i < header_->source_count; i++) {
+            TrajLogHeader source;
+            source.location = ReadString(&p, end, path);
+            source.uuid = ReadString(&p, end, path);
+            sources_.push_back(source);
+        }
+        if (!Consistent()) throw std::runtime_error("Corrupted index file: " + path);
+    }
+
+    const IndexHeader &header() const { return *header_; }
+    const IndexRow *rows() const { return rows_; }
+    const uint64_t *cells() const { return cells_; }
+    const TrackEntry *tracks() const { return tracks_; }
+    const uint32_t *track_rows() const { return track_rows_; }
+    const std::vector<TrajLogHeader> &sources() const { return sources_; }
+
+private:
+    template <typename T>
+    const T *Section(uint64_t offset, uint64_t count, const std::string &path) const {
+        if (offset % alignof(T) != 0 || offset > file_.size() || (file_.size() - offset) / sizeof(T) < count) {
+            throw std::runtime_error("Corrupted index file: " + path);
+        }
+        return reinterpret_cast<const T *>(file_.data() + offset);
+    }
+
+    // Checks that every index stored in the file is in range, so queries can
+    // use them unchecked.
+    bool Consistent() const {
+        const IndexHeader &h = *header_;
+        if (h.cell_size == 0 || h.cols == 0 || h.rows == 0) return false;
+        uint64_t cells = static_cast<uint64_t>(h.cols) * h.rows;
+        for (uint64_t i = 0; i < h.row_count; i++) {
+            if (rows_[i].source >= h.source_count || track_rows_[i] >= h.row_count) return false;
+        }
+        if (cells_[0] != 0 || cells_[cells] != h.row_count) return false;
+        for (uint64_t i = 0; i < cells; i++) {
+            if (cells_[i] > cells_[i + 1]) return false;
+        }
+        for (uint64_t i = 0; i < h.track_count; i++) {
+            const TrackEntry &track = tracks_[i];
+            if (track.first > h.row_count || track.count > h.row_count - track.first) return false;
+        }
+        return true;
+    }
+
+    static std::string ReadString(const char **p, const char *end, const std::string &path) {
+        uint32_t size;
+        if (end - *p < 4) throw std::runtime_error("Corrupted index file: " + path);
+        memcpy(&size, *p, 4);
+        *p += 4;
+        if (static_cast<size_t>(end - *p) < size) throw std::runtime_error("Corrupted index file: " + path);
+        std::string s(*p, size);
+        *p += size;
+        return s;
+    }
+
+    MappedFile file_;
+    const IndexHeader *header_;
+    const IndexRow *rows_;
+    const uint64_t *cells_;
+    const TrackEntry *tracks_;
+    const uint32_t *track_rows_;
+    std::vector<TrajLogHeader> sources_;
+};
+
+int32_t BottomX(const IndexRow &row) { return row.x + row.width / 2; }
+int32_t BottomY(const IndexRow &row) { return row.y + row.height; }
+
+uint32_t CellOf(int32_t v, uint32_t cell_size, uint32_t count) {
+    if (v < 0) return 0;
+    return std::min(static_cast<uint32_t>(v) / cell_size, count - 1);
+}
+
+// Local date of a timestamp as YYYY-MM-DD.
+std::string DayOf(uint64_t timestamp) {
+    time_t sec = static_cast<time_t>(timestamp / 1000);
+    struct tm local;
+    char buf[16];
+    localtime_r(&sec, &local);
+    strftime(buf, sizeof(buf), "%Y-%m-%d", &local);
+    return buf;
+}
+
+// Parses "YYYY-MM-DD HH:MM:SS" (local) or ms since epoch.
+uint64_t ParseTime(const std::string &s) {
+    if (!s.empty() && s.find_first_not_of("0123456789") == std::string::npos) {
+        return std::strtoull(s.c_str(), nullptr, 10);
+    }
+    struct tm local = tm();
+    const char *end = strptime(s.c_str(), "%Y-%m-%d %H:%M:%S", &local);
+    if (!end) end = strptime(s.c_str(), "%Y-%m-%dT%H:%M:%S", &local);
+    if (!end || *end != '\0') throw std::runtime_error("Invalid time " + s);
+    local.tm_isdst = -1;
+    return static_cast<uint64_t>(mktime(&local)) * 1000;
+}
+
+// Rows of the input logs, with their sources, grouped by day.
+class RowCollector {
+public:
+    void AddBinary(const char *data, size_t size) {
+        TrajLogReader reader(data, size);
+        uint32_t source = SourceId(Source(reader.header().location, reader.header().uuid));
+        std::vector<TrajRow> rows;
+        for (size_t i = 0; i < reader.blocks().size(); i++) {
+            reader.ReadBlock(i, &rows);
+            for (const auto &row : rows) Add(row, source);
+        }
+    }
+
+    // Returns the number of lines that could not be parsed.
+    size_t AddCsv(const char *data, size_t size) {
+        size_t skipped = 0;
+        CsvReader reader(data, size);
+        while (reader.Next()) {
+            if (!AddCsvRow(reader)) skipped++;
+        }
+        return skipped;
+    }
+
+    void AddIndex(const IndexFile &index) {
+        std::vector<uint32_t> sources;
+        for (const auto &source : index.sources()) {
+            sources.push_back(SourceId(Source(source.location, source.uuid)));
+        }
+        for (uint64_t i = 0; i < index.header().row_count; i++) {
+            IndexRow row = index.rows()[i];
+            row.source = sources[row.source];
+            days_[DayOf(row.timestamp)].push_back(row);
+        }
+    }
+
+    std::map<std::string, std::vector<IndexRow>> &days() { return days_; }
+    const std::vector<Source> &sources() const { return sources_; }
+
+private:
+    uint32_t SourceId(const Source &source) {
+        auto it = source_ids_.find(source);
+        if (it != source_ids_.end()) return it->second;
+        source_ids_.emplace(source, static_cast<uint32_t>(sources_.size()));
+        sources_.push_back(source);
+        return static_cast<uint32_t>(sources_.size() - 1);
+    }
+
+    void Add(const TrajRow &row, uint32_t source) {
+        IndexRow r{row.timestamp, row.frame_idx, row.object_id, row.x, row.y,
+                   row.width, row.height, row.confidence, source};
+        days_[DayOf(row.timestamp)].push_back(r);
+    }
+
+    bool AddCsvRow(const CsvReader &reader) {
+        // frame,time,person,x,y,width,height,confidence,location,uuid
+        TrajRow row;
+        if (reader.size() != 10 || !reader.Int(0, &row.frame_idx) ||
+            !ParseAscTime(reader.field(1).begin, reader.field(1).end, &row.timestamp) ||
+            !reader.Int(2, &row.object_id) || !reader.Int(3, &row.x) || !reader.Int(4, &row.y) ||
+            !reader.Int(5, &row.width) || !reader.Int(6, &row.height) || !reader.Float(7, &row.confidence)) {
+            return false;
+        }
+        Add(row, SourceId(Source(reader.field(8).str(), reader.field(9).str())));
+        return true;
+    }
+
+    std::map<Source, uint32_t> source_ids_;
+    std::vector<Source> sources_;
+    std::map<std::string, std::vector<IndexRow>> days_;
+};
+
+template <typename T>
+void WriteArray(std::ofstream &out, const std::vector<T> &v) {
+    out.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+}
+
+void WriteIndex(const std::string &path, std::vector<IndexRow> &rows,
+                const std::vector<Source> &all_sources, uint32_t cell_size) {
+    // A row is the same if it is the same person on the same frame of the
+    // same run, so adding a segment twice does not duplicate it.
+    std::sort(rows.begin(), rows.end(), [](const IndexRow &a, const IndexRow &b) {
+        if (a.source != b.source) return a.source < b.source;
+        if (a.frame_idx != b.frame_idx) return a.frame_idx < b.frame_idx;
+        return a.object_id < b.object_id;
+    });
+    rows.erase(std::unique(rows.begin(), rows.end(), [](const IndexRow &a, const IndexRow &b) {
+        return a.source == b.source && a.frame_idx == b.frame_idx && a.object_id == b.object_id;
+    }), rows.end());
+    if (rows.size() > UINT32_MAX) throw std::runtime_error("Too many rows for one day in " + path);
+
+    // Only the sources of this day are written, renumbered.
+    std::vector<uint32_t> source_map(all_sources.size(), UINT32_MAX);
+    std::vector<Source> sources;
+    for (auto &row : rows) {
+        if (source_map[row.source] == UINT32_MAX) {
+            source_map[row.source] = static_cast<uint32_t>(sources.size());
+            sources.push_back(all_sources[row.source]);
+        }
+        row.source = source_map[row.source];
+    }
+
+    IndexHeader header = IndexHeader();
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.cell_size = cell_size;
+    int32_t max_x = 0, max_y = 0;
+    header.first_time = UINT64_MAX;
+    for (const auto &row : rows) {
+        max_x = std::max(max_x, BottomX(row));
+        max_y = std::max(max_y, BottomY(row));
+        header.first_time = std::min(header.first_time, row.timestamp);
+        header.last_time = std::max(header.last_time, row.timestamp);
+    }
+    header.cols = std::min(static_cast<uint32_t>(max_x) / cell_size + 1, kMaxGridCells);
+    header.rows = std::min(static_cast<uint32_t>(max_y) / cell_size + 1, kMaxGridCells);
+    header.source_count = static_cast<uint32_t>(sources.size());
+    header.row_count = rows.size();
+
+    auto cell = [&header](const IndexRow &row) {
+        return CellOf(BottomY(row), header.cell_size, header.rows) * header.cols +
+               CellOf(BottomX(row), header.cell_size, header.cols);
+    };
+    std::sort(rows.begin(), rows.end(), [&cell](const IndexRow &a, const IndexRow &b) {
+        uint32_t ca = cell(a), cb = cell(b);
+        if (ca != cb) return ca < cb;
+        if (a.timestamp != b.timestamp) return a.timestamp < b.timestamp;
+        return a.frame_idx < b.frame_idx;
+    });
+    std::vector<uint64_t> cells(static_cast<size_t>(header.cols) * header.rows + 1, 0);
+    for (const auto &row : rows) cells[cell(row) + 1]++;
+    for (size_t i = 1; i < cells.size(); i++) cells[i] += cells[i - 1];
+
+    std::vector<uint32_t> track_rows(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) track_rows[i] = static_cast<uint32_t>(i);
+    std::sort(track_rows.begin(), track_rows.end(), [&rows](uint32_t a, uint32_t b) {
+        const IndexRow &ra = rows[a], &rb = rows[b];
+        if (ra.object_id != rb.object_id) return ra.object_id < rb.object_id;
+        if (ra.source != rb.source) return ra.source < rb.source;
+        if (ra.timestamp != rb.timestamp) return ra.timestamp < rb.timestamp;
+        return ra.frame_idx < rb.frame_idx;
+    });
+    std::vector<TrackEntry> tracks;
+    for (size_t i = 0; i < track_rows.size(); i++) {
+        const IndexRow &row = rows[track_rows[i]];
+        if (tracks.empty() || tracks.back().object_id != row.object_id || tracks.back().source != row.source) {
+            tracks.push_back(TrackEntry{row.object_id, row.source, row.timestamp, row.timestamp, i, 0});
+        }
+        tracks.back().last_time = row.timestamp;
+        tracks.back().count++;
+    }
+    header.track_count = tracks.size();
+
+    header.cells_offset = sizeof(IndexHeader) + rows.size() * sizeof(IndexRow);
+    header.tracks_offset = header.cells_offset + cells.size() * sizeof(uint64_t);
+    header.track_rows_offset = header.tracks_offset + tracks.size() * sizeof(TrackEntry);
+    header.sources_offset = header.track_rows_offset + track_rows.size() * sizeof(uint32_t);
+
+    // Written next to the old file and renamed, so queries never see a
+    // partial file.
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) throw std::runtime_error("Can't create " + tmp_path);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    WriteArray(out, rows);
+    WriteArray(out, cells);
+    WriteArray(out, tracks);
+    WriteArray(out, track_rows);
+    for (const auto &source : sources) {
+        for (const std::string *s : {&source.first, &source.second}) {
+            uint32_t size = static_cast<uint32_t>(s->size());
+            out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+            out.write(s->data(), s->size());
+        }
+    }
+    out.close();
+    if (!out) throw std::runtime_error("Can't write " + tmp_path);
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) throw std::runtime_error("Can't replace " + path);
+}
+
+bool FileExists(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+int Build(const std::string &dir, const std::vector<std::string> &inputs, uint32_t cell_size) {
+    RowCollector collector;
+    for (const auto &input : inputs) {
+        MappedFile file(input);
+        if (TrajLogReader::IsTrajLog(file.data(), file.size())) {
+            collector.AddBinary(file.data(), file.size());
+        } else if (size_t skipped = collector.AddCsv(file.data(), file.size())) {
+            std::cerr << "[Warning]: Skipped " << skipped << " invalid lines of " << input << std::endl;
+        }
+    }
+
+    // Existing days are read before any file is replaced.
+    std::vector<std::string> days;
+    for (const auto &day : collector.days()) days.push_back(day.first);
+    for (const auto &day : days) {
+        std::string path = dir + "/" + day + kIndexSuffix;
+        if (FileExists(path)) collector.AddIndex(IndexFile(path));
+    }
+
+    for (auto &day : collector.days()) {
+        std::string path = dir + "/" + day.first + kIndexSuffix;
+        WriteIndex(path, day.second, collector.sources(), cell_size);
+        std::cerr << path << ": " << day.second.size() << " rows" << std::endl;
+        std::vector<IndexRow>().swap(day.second);
+    }
+    return 0;
+}
+
+struct Query {
+    bool has_box;
+    int32_t x0, y0, x1, y1;  ///< Inclusive box of bottom points.
+    uint64_t from;           ///< Inclusive.
+    uint64_t to;             ///< Exclusive.
+    bool has_id;
+    int32_t object_id;
+    std::string uuid;        ///< Empty for any run.
+
+    bool Matches(const IndexRow &row) const {
+        if (row.timestamp < from || row.timestamp >= to) return false;
+        if (!has_box) return true;
+        int32_t x = BottomX(row), y = BottomY(row);
+        return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+    }
+};
+
+void QueryFile(const IndexFile &index, const Query &query, std::vector<const IndexRow *> *found) {
+    const IndexHeader &header = index.header();
+    if (header.row_count == 0 || header.last_time < query.from || header.first_time >= query.to) return;
+
+    if (query.has_id) {
+        const TrackEntry *begin = index.tracks(), *end = begin + header.track_count;
+        auto first = std::lower_bound(begin, end, query.object_id,
+                                      [](const TrackEntry &t, int32_t id) { return t.object_id < id; });
+        for (auto track = first; track != end && track->object_id == query.object_id; ++track) {
+            if (!query.uuid.empty() && index.sources()[track->source].uuid.compare(0, query.uuid.size(), query.uuid) != 0) {
+                continue;
+            }
+            if (track->last_time < query.from || track->first_time >= query.to) continue;
+            for (uint64_t i = track->first; i < track->first + track->count; i++) {
+                const IndexRow &row = index.rows()[index.track_rows()[i]];
+                if (query.Matches(row)) found->push_back(&row);
+            }
+        }
+        return;
+    }
+
+    uint32_t cx0 = 0, cy0 = 0, cx1 = header.cols - 1, cy1 = header.rows - 1;
+    if (query.has_box) {
+        if (query.x1 < 0 || query.y1 < 0) return;
+        cx0 = CellOf(query.x0, header.cell_size, header.cols);
+        cy0 = CellOf(query.y0, header.cell_size, header.rows);
+        cx1 = CellOf(query.x1, header.cell_size, header.cols);
+        cy1 = CellOf(query.y1, header.cell_size, header.rows);
+    }
+    for (uint32_t cy = cy0; cy <= cy1; cy++) {
+        for (uint32_t cx = cx0; cx <= cx1; cx++) {
+            size_t cell = static_cast<size_t>(cy) * header.cols + cx;
+            const IndexRow *begin = index.rows() + index.cells()[cell];
+            const IndexRow *end = index.rows() + index.cells()[cell + 1];
+            auto row = std::lower_bound(begin, end, query.from,
+                                        [](const IndexRow &r, uint64_t t) { return r.timestamp < t; });
+            for (; row != end && row->timestamp < query.to; ++row) {
+                if (query.Matches(*row)) found->push_back(&*row);
+            }
+        }
+    }
+}
+
+int RunQuery(const std::string &dir, const Query &query, const std::string &format) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> paths;
+    DIR *d = opendir(dir.c_str());
+    if (!d) throw std::runtime_error("Can't open " + dir);
+    // Day files sort by name; days outside the window are never opened.
+    std::string first_day = query.from > 0 ? DayOf(query.from) : "";
+    std::string last_day = query.to < UINT64_MAX ? DayOf(query.to - 1) : "~";
+    const size_t suffix = sizeof(kIndexSuffix) - 1;
+    while (struct dirent *entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.size() <= suffix || name.compare(name.size() - suffix, suffix, kIndexSuffix) != 0) continue;
+        std::string day = name.substr(0, name.size() - suffix);
+        if (day >= first_day && day <= last_day) paths.push_back(dir + "/" + name);
+    }
+    closedir(d);
+    std::sort(paths.begin(), paths.end());
+
+    size_t total = 0;
+    std::string out;
+    std::vector<const IndexRow *> found;
+    for (const auto &path : paths) {
+        IndexFile index(path);
+        found.clear();
+        QueryFile(index, query, &found);
+        total += found.size();
+        if (format == "count") continue;
+        std::sort(found.begin(), found.end(), [](const IndexRow *a, const IndexRow *b) {
+            if (a->timestamp != b->timestamp) return a->timestamp < b->timestamp;
+            if (a->source != b->source) return a->source < b->source;
+            if (a->frame_idx != b->frame_idx) return a->frame_idx < b->frame_idx;
+            return a->object_id < b->object_id;
+        });
+        for (const IndexRow *r : found) {
+            TrajRow row{r->frame_idx, r->object_id, r->x, r->y, r->width, r->height, r->confidence, r->timestamp};
+            if (format == "csv") {
+                AppendTrajRowCsv(index.sources()[r->source], row, &out);
+            } else {
+                AppendTrajRowJson(index.sources()[r->source], row, &out);
+            }
+            if (out.size() > (1 << 20)) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        }
+        fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+    }
+    if (format == "count") std::cout << total << std::endl;
+
+    auto ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << total << " rows from " << paths.size() << " day files in " << ms.count() / 1000.0 << " ms"
+              << std::endl;
+    return 0;
+}
+}  // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || (std::string(argv[1]) != "build" && std::string(argv[1]) != "query")) {
+        std::cerr << "Invalid arguments!" << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    std::string dir = argv[2];
+
+    try {
+        if (command == "build") {
+            uint32_t cell_size = 32;
+            std::vector<std::string> inputs;
+            for (int i = 3; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg == "-cell" && i + 1 < argc) {
+                    cell_size = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+                } else {
+                    inputs.push_back(arg);
+                }
+            }
+            if (inputs.empty()) {
+                std::cerr << "No input logs!" << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            return Build(dir, inputs, cell_size);
+        }
+
+        Query query{false, 0, 0, 0, 0, 0, UINT64_MAX, false, 0, ""};
+        std::string format = "csv";
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "-box" && i + 4 < argc) {
+                query.has_box = true;
+                query.x0 = atoi(argv[++i]);
+                query.y0 = atoi(argv[++i]);
+                query.x1 = atoi(argv[++i]);
+                query.y1 = atoi(argv[++i]);
+                if (query.x0 > query.x1) std::swap(query.x0, query.x1);
+                if (query.y0 > query.y1) std::swap(query.y0, query.y1);
+            } else if (arg == "-from" && i + 1 < argc) {
+                query.from = ParseTime(argv[++i]);
+            } else if (arg == "-to" && i + 1 < argc) {
+                query.to = ParseTime(argv[++i]);
+            } else if (arg == "-id" && i + 1 < argc) {
+                query.has_id = true;
+                query.object_id = atoi(argv[++i]);
+            } else if (arg == "-uuid" && i + 1 < argc) {
+                query.uuid = argv[++i];
+            } else if (arg == "csv" || arg == "ndjson" || arg == "count") {
+                format = arg;
+            } else {
+                std::cerr << "Unknown argument " << arg << std::endl;
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (query.from >= query.to) {
+            std::cerr << "Empty time window" << std::endl;
+            return 1;
+        }
+        return RunQuery(dir, query, format);
+    }
+    catch (const std::exception& error) {
+        std::cerr << "[ ERROR ] " << error.what() << std::endl;
+        return 1;
+    }
+}